@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Microbenchmark of the implementations of the activation functions.
+ * 
+ * For each implementation (piecewise polynomial, lookup table and C library),
+ * prints the time taken to compute the sigmoid-like and gaussian-like
+ * functions on a vector of four values and the mean and maximum absolute
+ * error with regard to the smooth functions they approximate, computed in
+ * double precision with tanh() and exp() from the C library.
+ * 
+ * Usage: activation-bench [repetitions] */
+
+#include <sys/time.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "activation.h"
+
+#define DEFAULT_REPETITIONS     2000
+
+/* Number of vectors of arguments */
+#define SAMPLES                 4096
+
+/* Range of the arguments, a bit wider than where the functions vary */
+#define RANGE                   8.0
+
+#define IMPLEMENTATIONS         3
+
+typedef genome_f4_t (*activation_func_t)(genome_f4_t);
+
+static const char *names[IMPLEMENTATIONS] = {"polynomial", "lookup table", "C library"};
+
+static const activation_func_t sigmoids[IMPLEMENTATIONS] = {sigmoid_polynomial, sigmoid_lut, sigmoid_exact};
+
+static const activation_func_t gaussians[IMPLEMENTATIONS] = {gaussian_polynomial, gaussian_lut, gaussian_exact};
+
+/* Same as sigmoid_exact(): the logistic function 1 / (1 + exp(-0.6 t)) */
+static double reference_sigmoid(double t) {
+    return 0.5 + 0.5 * tanh(0.3 * t);
+}
+
+/* Same as gaussian_exact() */
+static double reference_gaussian(double t) {
+    return exp(-0.12 * t * t);
+}
+
+static double elapsed_ns(const struct timeval *start, const struct timeval *end) {
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_usec - start->tv_usec) * 1e3;
+}
+
+/* Average time per vector, in nanoseconds. The function is inlined in the
+ * loop through the switch so the measure does not include a function call.
+ * Results are stored rather than summed so the measure is the throughput, not
+ * the latency of the additions. */
+static double measure(int implementation, bool gaussian_curve, const gene_chunk_t *args, gene_chunk_t *results, int repetitions, float *sink) {
+    struct timeval  start;
+    struct timeval  end;
+    int             rep;
+    int             idx;
+    
+    gettimeofday(&start, NULL);
+    
+    for(rep = 0; rep < repetitions; ++rep) {
+        for(idx = 0; idx < SAMPLES; ++idx) {
+            switch(2 * implementation + gaussian_curve) {
+            case 0:
+                results[idx].v = sigmoid_polynomial(args[idx].v);
+                break;
+            case 1:
+                results[idx].v = gaussian_polynomial(args[idx].v);
+                break;
+            case 2:
+                results[idx].v = sigmoid_lut(args[idx].v);
+                break;
+            case 3:
+                results[idx].v = gaussian_lut(args[idx].v);
+                break;
+            case 4:
+                results[idx].v = sigmoid_exact(args[idx].v);
+                break;
+            default:
+                results[idx].v = gaussian_exact(args[idx].v);
+            }
+        }
+        
+        *sink += results[rep % SAMPLES].f[0];
+    }
+    
+    gettimeofday(&end, NULL);
+    
+    return elapsed_ns(&start, &end) / ((double)repetitions * SAMPLES);
+}
+
+static void error(activation_func_t function, double (*reference)(double), const gene_chunk_t *args, double *mean, double *max) {
+    gene_chunk_t    result;
+    double          diff;
+    int             idx, idy;
+    
+    *mean   = 0.0;
+    *max    = 0.0;
+    
+    for(idx = 0; idx < SAMPLES; ++idx) {
+        result.v = function(args[idx].v);
+        
+        for(idy = 0; idy < 4; ++idy) {
+            diff    = fabs(result.f[idy] - reference(args[idx].f[idy]));
+            *mean  += diff;
+            
+            if(diff > *max) {
+                *max = diff;
+            }
+        }
+    }
+    
+    *mean /= 4.0 * SAMPLES;
+}
+
+int main(int argc, char *argv[]) {
+    gene_chunk_t   *args;
+    gene_chunk_t   *results;
+    double          time_sigmoid;
+    double          time_gaussian;
+    double          mean_sigmoid, max_sigmoid;
+    double          mean_gaussian, max_gaussian;
+    float           sink;
+    int             repetitions;
+    int             implementation;
+    int             idx, idy;
+    
+    repetitions = DEFAULT_REPETITIONS;
+    
+    if(argc > 1) {
+        repetitions = atoi(argv[1]);
+    }
+    
+    args    = memalign(16, SAMPLES * sizeof(gene_chunk_t));
+    results = memalign(16, SAMPLES * sizeof(gene_chunk_t));
+    
+    if(args == NULL || results == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    
+    srand(1);
+    
+    for(idx = 0; idx < SAMPLES; ++idx) {
+        for(idy = 0; idy < 4; ++idy) {
+            args[idx].f[idy] = RANGE * (2.0 * (float)rand() / (float)RAND_MAX - 1.0);
+        }
+    }
+    
+#ifdef __AVX2__
+    printf("lookup table: %d intervals, AVX2 gather\n\n", ACTIVATION_LUT_SIZE);
+#else
+    printf("lookup table: %d intervals, scalar loads\n\n", ACTIVATION_LUT_SIZE);
+#endif
+    printf("%-14s %-30s %-30s\n", "", "sigmoid-like", "gaussian-like");
+    printf("%-14s %9s %9s %10s %9s %9s %10s\n", "implementation", "ns/vector", "mean err", "max err", "ns/vector", "mean err", "max err");
+    printf("%-14s %9s %9s %10s %9s %9s %10s\n", "--------------", "---------", "---------", "----------", "---------", "---------", "----------");
+    
+    sink = 0.0;
+    
+    for(implementation = 0; implementation < IMPLEMENTATIONS; ++implementation) {
+        time_sigmoid    = measure(implementation, false, args, results, repetitions, &sink);
+        time_gaussian   = measure(implementation, true,  args, results, repetitions, &sink);
+        
+        error(sigmoids[implementation],  reference_sigmoid,  args, &mean_sigmoid,  &max_sigmoid);
+        error(gaussians[implementation], reference_gaussian, args, &mean_gaussian, &max_gaussian);
+        
+        printf("%-14s %9.2f %9.2e %10.2e %9.2f %9.2e %10.2e\n",
+                names[implementation],
+                time_sigmoid,
+                mean_sigmoid,
+                max_sigmoid,
+                time_gaussian,
+                mean_gaussian,
+                max_gaussian);
+    }
+    
+    /* prevents the compiler from optimizing the computations away */
+    if(sink == 0.12345f) {
+        printf("\n");
+    }
+    
+    free(args);
+    free(results);
+    
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "activation.h"
+
+activation_lut_t activation_sigmoid_lut;
+
+activation_lut_t activation_gaussian_lut;
+
+static void fill_lut(activation_lut_t *lut, genome_f4_t (*function)(genome_f4_t)) {
+    gene_chunk_t    chunk;
+    int             idx;
+    
+    for(idx = 0; idx <= ACTIVATION_LUT_SIZE; ++idx) {
+        chunk.v = _mm_set1_ps(-ACTIVATION_LIMIT + idx * (2.0 * ACTIVATION_LIMIT / ACTIVATION_LUT_SIZE));
+        chunk.v = function(chunk.v);
+        
+        lut->value[idx] = chunk.f[0];
+    }
+    
+    for(idx = 0; idx < ACTIVATION_LUT_SIZE; ++idx) {
+        lut->slope[idx] = lut->value[idx + 1] - lut->value[idx];
+    }
+    
+    lut->slope[ACTIVATION_LUT_SIZE] = 0.0;
+}
+
+/* The lookup tables are filled before main() is called. */
+static void __attribute__ ((constructor)) activation_init(void) {
+    fill_lut(&activation_sigmoid_lut,  sigmoid_polynomial);
+    fill_lut(&activation_gaussian_lut, gaussian_polynomial);
+}
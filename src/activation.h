@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CRITTERS_ACTIVATION_H_
+#define CRITTERS_ACTIVATION_H_
+
+#include <emmintrin.h>
+#include <math.h>
+#include <xmmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "genome.h"
+
+/* Implementations of the sigmoid-like and gaussian-like activation functions */
+
+/* Piecewise polynomials (see sigmoid_polynomial() and gaussian_polynomial()) */
+#define ACTIVATION_POLYNOMIAL   0
+
+/* Linear interpolation in lookup tables of the piecewise polynomials. With
+ * AVX2 enabled (e.g. configured with CFLAGS=-mavx2), the table lookups use
+ * gather instructions. */
+#define ACTIVATION_LUT          1
+
+/* Smooth functions computed with expf() from the C library, with the same
+ * slope (sigmoid) or curvature (gaussian) at zero as the polynomials */
+#define ACTIVATION_EXACT        2
+
+/* Implementation used by the brain (see src/activation-bench.c to compare
+ * their speed and accuracy) */
+#define ACTIVATION_IMPLEMENTATION   ACTIVATION_POLYNOMIAL
+
+/* Number of intervals of the lookup tables */
+#define ACTIVATION_LUT_SIZE     256
+
+/* Both curves are constant outside of [-ACTIVATION_LIMIT, ACTIVATION_LIMIT]. */
+#define ACTIVATION_LIMIT        5.0
+
+
+typedef struct activation_lut_t activation_lut_t;
+
+/* Value of the function at the start of each interval and its slope within the
+ * interval. The extra entry is for the upper limit. */
+struct activation_lut_t {
+    float   value[ACTIVATION_LUT_SIZE + 1];
+    float   slope[ACTIVATION_LUT_SIZE + 1];
+} __attribute__ ((aligned (64)));
+
+extern activation_lut_t activation_sigmoid_lut;
+
+extern activation_lut_t activation_gaussian_lut;
+
+
+/* This function and the next few ones use compiler intrinsic functions for SSE2
+ * instructions that act on vectors of four floating point values. The return
+ * value and all arguments of these functions are vectors of four floating point
+ * values. */
+static inline genome_f4_t mux(genome_f4_t cond, genome_f4_t vthen, genome_f4_t velse) {
+    /* mux(p, a, b) = p ? a : b
+     *              = p & a | ~p & b */
+    return _mm_or_ps(
+                _mm_and_ps(cond, vthen),
+                _mm_andnot_ps(cond, velse) );
+}
+
+static inline genome_f4_t mux_if_less(genome_f4_t op1, genome_f4_t op2, genome_f4_t vthen, genome_f4_t velse) {
+    genome_f4_t cond;
+    
+    cond = _mm_cmplt_ps(op1, op2);
+    
+    return mux(cond, vthen, velse);
+}
+
+static inline genome_f4_t mux_if_between(genome_f4_t op, genome_f4_t low, genome_f4_t high, genome_f4_t vthen, genome_f4_t velse) {
+    genome_f4_t cond;
+    
+    cond = _mm_and_ps(
+        _mm_cmplt_ps(low, op),
+        _mm_cmplt_ps(op,  high) );
+
+    return mux(cond, vthen, velse);
+}
+
+/* Rectifier activation function (ReLU) */
+static inline genome_f4_t relu(genome_f4_t t) {
+    return mux_if_less(t, _mm_set1_ps(0.0), _mm_set1_ps(0.0), t);
+}
+
+/* Piecewise polynomial approximation of a sigmoid-like curve
+ * 
+ * The value of the function is zero for arguments under -5 and one for 
+ * arguments over 5. Between -5 and 5, the value of the function is the value of
+ * a degree 3 polynomial with the following characteristics:
+ * 
+ *  - The polynomial has value 0 at -5 and 1 at 5 so as not to have
+ *    discontinuities.
+ *  - The first derivative is zero at -5 and 5 to prevent discontinuities of
+ *    that derivative.
+ * 
+ *  */
+static inline genome_f4_t sigmoid_polynomial(genome_f4_t t) {
+    genome_f4_t poly;
+    genome_f4_t mux1;
+    genome_f4_t mux2;
+    
+    /* compute polynomial:
+     *      poly(t) =  -0.002 * t^3 + 0.15 * t + 0.5
+     *              = (-0.002 * t^2 + 0.15) * t + 0.5 */
+    poly = (_mm_set1_ps(-0.002) * t*t + _mm_set1_ps(0.15)) * t + _mm_set1_ps(0.5);
+    
+    /* select poly if -5 < t < 5, 0 if t < -5, 1 otherwise (t > 5) */
+    mux1 = mux_if_less(t, _mm_set1_ps(-5.0), _mm_set1_ps(0.0), poly);
+    mux2 = mux_if_less(t, _mm_set1_ps( 5.0), mux1, _mm_set1_ps(1.0));
+            
+    return mux2;
+}
+
+/* Piecewise polynomial approximation of a gaussian-like curve
+ * 
+ * The value of the function is zero for arguments under -5 and over 5. Between
+ * -5 and 0 the value of the function is the value of a degree 3 polynomial,
+ * whereas between 0 and 5, it is the value of that same polynomial computed on
+ * the inverse of the argument (i.e. p(-x)). The coefficients of the polynomial
+ * have been computed with the following constraints in mind:
+ * 
+ *  - The polynomial has value 0 at -5 and 1 at 0 so as not to have
+ *    discontinuities.
+ *  - The first derivative is zero at -5 and 0 to prevent discontinuities of
+ *    that derivative. 
+
+ *  */
+static inline genome_f4_t gaussian_polynomial(genome_f4_t t) {
+    genome_f4_t a;
+    genome_f4_t poly;
+    
+    /* select coefficient: a = -0.016 if t < 0, 0.016 otherwise */
+    a = mux_if_less(t, _mm_set1_ps(0.0), _mm_set1_ps(-0.016), _mm_set1_ps(0.016));
+    
+   /* compute polynomial:
+     *      poly(t) =  +/-0.016 * t^3 - 0.12 * t^2 + 1.0
+     *              =         a * t^3 - 0.12 * t^2 + 1.0
+     *              =        (a * t - 0.12) * t^2 + 1.0 */
+    poly = (a * t - _mm_set1_ps(0.12)) * t*t + _mm_set1_ps(1.0);
+    
+    /* select poly if -5 < t < 5, 0 otherwise */
+    return mux_if_between(t, _mm_set1_ps(-5.0), _mm_set1_ps(5.0), poly, _mm_set1_ps(0.0));
+}
+
+static inline genome_f4_t lut_lookup(const activation_lut_t *lut, genome_f4_t t) {
+    genome_f4_t     x;
+    genome_f4_t     value;
+    genome_f4_t     slope;
+    __m128i         index;
+#ifndef __AVX2__
+    union {
+        __m128i     v;
+        int32_t     i[4];
+    } indices;
+#endif
+    
+    /* position within the table, clamped to the limits */
+    x = _mm_min_ps(_mm_max_ps(t, _mm_set1_ps(-ACTIVATION_LIMIT)), _mm_set1_ps(ACTIVATION_LIMIT));
+    x = (x + _mm_set1_ps(ACTIVATION_LIMIT)) * _mm_set1_ps(ACTIVATION_LUT_SIZE / (2.0 * ACTIVATION_LIMIT));
+    
+    /* x >= 0, so truncation is the same as rounding down */
+    index = _mm_cvttps_epi32(x);
+    x    -= _mm_cvtepi32_ps(index);
+    
+#ifdef __AVX2__
+    value = _mm_i32gather_ps(lut->value, index, sizeof(float));
+    slope = _mm_i32gather_ps(lut->slope, index, sizeof(float));
+#else
+    indices.v = index;
+    value = _mm_setr_ps(
+            lut->value[indices.i[0]],
+            lut->value[indices.i[1]],
+            lut->value[indices.i[2]],
+            lut->value[indices.i[3]] );
+    slope = _mm_setr_ps(
+            lut->slope[indices.i[0]],
+            lut->slope[indices.i[1]],
+            lut->slope[indices.i[2]],
+            lut->slope[indices.i[3]] );
+#endif
+    
+    return value + x * slope;
+}
+
+static inline genome_f4_t sigmoid_lut(genome_f4_t t) {
+    return lut_lookup(&activation_sigmoid_lut, t);
+}
+
+static inline genome_f4_t gaussian_lut(genome_f4_t t) {
+    return lut_lookup(&activation_gaussian_lut, t);
+}
+
+/* Logistic function with a slope of 0.15 at zero, like the polynomial */
+static inline genome_f4_t sigmoid_exact(genome_f4_t t) {
+    gene_chunk_t chunk;
+    int          idx;
+    
+    chunk.v = t;
+    
+    for(idx = 0; idx < 4; ++idx) {
+        chunk.f[idx] = 1.0f / (1.0f + expf(-0.6f * chunk.f[idx]));
+    }
+    
+    return chunk.v;
+}
+
+/* Gaussian function with a second derivative of -0.24 at zero, like the
+ * polynomial */
+static inline genome_f4_t gaussian_exact(genome_f4_t t) {
+    gene_chunk_t chunk;
+    int          idx;
+    
+    chunk.v = t;
+    
+    for(idx = 0; idx < 4; ++idx) {
+        chunk.f[idx] = expf(-0.12f * chunk.f[idx] * chunk.f[idx]);
+    }
+    
+    return chunk.v;
+}
+
+static inline genome_f4_t sigmoid(genome_f4_t t) {
+    switch(ACTIVATION_IMPLEMENTATION) {
+    case ACTIVATION_LUT:
+        return sigmoid_lut(t);
+    case ACTIVATION_EXACT:
+        return sigmoid_exact(t);
+    default:
+        return sigmoid_polynomial(t);
+    }
+}
+
+static inline genome_f4_t gaussian(genome_f4_t t) {
+    switch(ACTIVATION_IMPLEMENTATION) {
+    case ACTIVATION_LUT:
+        return gaussian_lut(t);
+    case ACTIVATION_EXACT:
+        return gaussian_exact(t);
+    default:
+        return gaussian_polynomial(t);
+    }
+}
+
+#endif
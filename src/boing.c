@@ -34,6 +34,12 @@
 bool boing_init(boing_t *boing, float speed, int dir) {
     boing->speed_mult = speed * (1.0 / M_SQRT2);
     
+    boing_set_direction(boing, dir);
+    
+    return true;
+}
+
+void boing_set_direction(boing_t *boing, int dir) {
     if((dir & 1) == 0) {    
         boing->go_left = true;
     }
@@ -49,8 +55,6 @@ bool boing_init(boing_t *boing, float speed, int dir) {
     else {
         boing->go_down = false;
     }
-    
-    return true;
 }
 
 void boing_update_thing_position(boing_t *boing, thing_t* thing, float delta, float w, float h) {
@@ -44,6 +44,8 @@ struct boing_t {
 
 bool boing_init(boing_t *boing, float speed, int dir);
 
+void boing_set_direction(boing_t *boing, int dir);
+
 void boing_update_thing_position(boing_t *boing, thing_t* thing, float delta, float w, float h);
 
 #endif
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Microbenchmark of the brain computation.
+ * 
+ * For a series of topologies (each activation function with several hidden
+ * layer sizes, and a few with multiple or recurrent layers), computes the
+ * brains of a population of critters with random genomes for a stream of
+ * random stimuli, first one critter at a time with brain_control_compute(),
+ * then in batches with brain_control_compute_batch(). The time and the number
+ * of instructions (when the perf_event_open() system call is available) per
+ * critter-step are printed in CSV format.
+ * 
+ * Usage: brain-bench [steps] */
+
+#define _GNU_SOURCE
+#include <sys/time.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include "breeder.h"
+#include "brain.h"
+#include "genome.h"
+
+#define DEFAULT_STEPS       2000
+
+/* Number of critters, as in a generation */
+#define CRITTERS            BREEDER_POPULATION_SIZE
+
+/* Number of stimuli in the stream of each critter, used in turn */
+#define STIMULI             64
+
+/* Same as SCENE_BRAIN_BATCH in scene.c */
+#define BATCH               32
+
+typedef struct {
+    genome_t           *genome;
+    brain_compiled_t    compiled;
+    brain_state_t       state;
+    brain_control_t     control;
+    stimuli_t           stimuli[STIMULI];
+} bench_critter_t;
+
+static const char *topologies[] = {
+    "4s", "8s", "12s", "16s",
+    "4g", "8g", "12g", "16g",
+    "4r", "8r", "12r", "16r",
+    "4s4g8r",
+    "8r/8r", "16r/16r", "8r/8r/8r",
+    "8s+", "8r/8s+"
+};
+
+#define TOPOLOGIES  (sizeof(topologies) / sizeof(topologies[0]))
+
+static inline float random_unit(void) {
+    return (float)rand() / (float)RAND_MAX;
+}
+
+static void random_stimuli(stimuli_t *stimuli) {
+    stimuli->food_intensity     = random_unit();
+    stimuli->food_angle         = 2.0 * random_unit() - 1.0;
+    stimuli->danger_intensity   = random_unit();
+    stimuli->danger_angle       = 2.0 * random_unit() - 1.0;
+    stimuli->wall_intensity     = random_unit();
+    stimuli->wall_angle         = 2.0 * random_unit() - 1.0;
+    stimuli->food_odour         = random_unit();
+    stimuli->danger_odour       = random_unit();
+}
+
+/* Hardware counter of the instructions executed by this thread in user mode,
+ * or -1 if not available */
+static int counter_open(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    
+    memset(&attr, 0, sizeof(attr));
+    
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static void counter_start(int counter) {
+#ifdef __linux__
+    if(counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+static int64_t counter_stop(int counter) {
+#ifdef __linux__
+    int64_t count;
+    
+    if(counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        
+        if(read(counter, &count, sizeof(count)) == sizeof(count)) {
+            return count;
+        }
+    }
+#endif
+    return -1;
+}
+
+static void run_single(bench_critter_t *critters, int steps) {
+    int step;
+    int idx;
+    
+    for(step = 0; step < steps; ++step) {
+        for(idx = 0; idx < CRITTERS; ++idx) {
+            brain_control_compute(
+                    &critters[idx].control,
+                    &critters[idx].compiled,
+                    &critters[idx].stimuli[step % STIMULI],
+                    &critters[idx].state);
+        }
+    }
+}
+
+static void run_batch(bench_critter_t *critters, int steps) {
+    brain_job_t jobs[BATCH];
+    int         step;
+    int         count;
+    int         idx;
+    
+    for(step = 0; step < steps; ++step) {
+        count = 0;
+        
+        for(idx = 0; idx < CRITTERS; ++idx) {
+            jobs[count].control     = &critters[idx].control;
+            jobs[count].compiled    = &critters[idx].compiled;
+            jobs[count].stimuli     = &critters[idx].stimuli[step % STIMULI];
+            jobs[count].state       = &critters[idx].state;
+            
+            if(++count == BATCH) {
+                brain_control_compute_batch(jobs, count);
+                count = 0;
+            }
+        }
+        
+        brain_control_compute_batch(jobs, count);
+    }
+}
+
+static void report(const char *topology, const char *mode, const struct timeval *start, const struct timeval *end, int64_t instructions, int steps) {
+    double critter_steps;
+    double ns;
+    
+    critter_steps = (double)steps * CRITTERS;
+    ns  = (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_usec - start->tv_usec) * 1e3;
+    
+    if(instructions >= 0) {
+        printf("%s,%s,%.2f,%.1f\n", topology, mode, ns / critter_steps, (double)instructions / critter_steps);
+    }
+    else {
+        printf("%s,%s,%.2f,\n", topology, mode, ns / critter_steps);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    genome_topology_t    topology;
+    bench_critter_t     *critters;
+    struct timeval       start;
+    struct timeval       end;
+    int64_t              instructions;
+    int                  counter;
+    int                  steps;
+    int                  idx, idy;
+    size_t               idt;
+    
+    steps = DEFAULT_STEPS;
+    
+    if(argc > 1) {
+        steps = atoi(argv[1]);
+    }
+    
+    critters = memalign(64, CRITTERS * sizeof(bench_critter_t));
+    
+    if(critters == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    
+    counter = counter_open();
+    
+    printf("topology,mode,ns_per_critter_step,instructions_per_critter_step\n");
+    
+    for(idt = 0; idt < TOPOLOGIES; ++idt) {
+        if(!genome_topology_parse(&topology, topologies[idt])) {
+            fprintf(stderr, "Invalid topology: %s\n", topologies[idt]);
+            continue;
+        }
+        
+        /* no genome must exist when the topology is changed */
+        brain_set_topology(&topology);
+        
+        srand(1);
+        
+        for(idx = 0; idx < CRITTERS; ++idx) {
+            critters[idx].genome = genome_new();
+            
+            if(critters[idx].genome == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return EXIT_FAILURE;
+            }
+            
+            genome_make_random(critters[idx].genome);
+            brain_compile(&critters[idx].compiled, critters[idx].genome);
+            brain_state_init(&critters[idx].state);
+            brain_control_init(&critters[idx].control);
+            
+            for(idy = 0; idy < STIMULI; ++idy) {
+                random_stimuli(&critters[idx].stimuli[idy]);
+            }
+        }
+        
+        /* warm up */
+        run_single(critters, steps / 10 + 1);
+        
+        gettimeofday(&start, NULL);
+        counter_start(counter);
+        run_single(critters, steps);
+        instructions = counter_stop(counter);
+        gettimeofday(&end, NULL);
+        
+        report(topologies[idt], "single", &start, &end, instructions, steps);
+        
+        gettimeofday(&start, NULL);
+        counter_start(counter);
+        run_batch(critters, steps);
+        instructions = counter_stop(counter);
+        gettimeofday(&end, NULL);
+        
+        report(topologies[idt], "batch", &start, &end, instructions, steps);
+        
+        for(idx = 0; idx < CRITTERS; ++idx) {
+            genome_free(critters[idx].genome);
+        }
+    }
+    
+    if(counter >= 0) {
+        close(counter);
+    }
+    
+    free(critters);
+    
+    return EXIT_SUCCESS;
+}
@@ -26,120 +26,106 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <emmintrin.h>
 #include <math.h>
 #include <xmmintrin.h>
+#include "activation.h"
 #include "brain.h"
 
 
-/* This function and the next few ones use compiler intrinsic functions for SSE2
- * instructions that act on vectors of four floating point values. The return
- * value and all arguments of these functions are vectors of four floating point
- * values. */
-static inline genome_f4_t mux(genome_f4_t cond, genome_f4_t vthen, genome_f4_t velse) {
-    /* mux(p, a, b) = p ? a : b
-     *              = p & a | ~p & b */
-    return _mm_or_ps(
-                _mm_and_ps(cond, vthen),
-                _mm_andnot_ps(cond, velse) );
-}
+/* Fixed-point formats for the reduced precision computation: number of
+ * fractional bits of the weights, the inputs of the hidden layer (stimuli) and
+ * the inputs of the output layer (hidden layer activations). With weights
+ * within +/-GENOME_WEIGHT_AMPLITUDE, the 32-bit accumulators cannot
+ * overflow. */
+#define FIXED_WEIGHT_BITS   10
 
-static inline genome_f4_t mux_if_less(genome_f4_t op1, genome_f4_t op2, genome_f4_t vthen, genome_f4_t velse) {
-    genome_f4_t cond;
-    
-    cond = _mm_cmplt_ps(op1, op2);
-    
-    return mux(cond, vthen, velse);
-}
+#define FIXED_INPUT_BITS    12
 
-static inline genome_f4_t mux_if_between(genome_f4_t op, genome_f4_t low, genome_f4_t high, genome_f4_t vthen, genome_f4_t velse) {
-    genome_f4_t cond;
-    
-    cond = _mm_and_ps(
-        _mm_cmplt_ps(low, op),
-        _mm_cmplt_ps(op,  high) );
+#define FIXED_HIDDEN_BITS    5
 
-    return mux(cond, vthen, velse);
-}
 
-/* Rectifier activation function (ReLU) */
-static inline genome_f4_t relu(genome_f4_t t) {
-    return mux_if_less(t, _mm_set1_ps(0.0), _mm_set1_ps(0.0), t);
-}
-
-/* Piecewise polynomial approximation of a sigmoid-like curve
- * 
- * The value of the function is zero for arguments under -5 and one for 
- * arguments over 5. Between -5 and 5, the value of the function is the value of
- * a degree 3 polynomial with the following characteristics:
- * 
- *  - The polynomial has value 0 at -5 and 1 at 5 so as not to have
- *    discontinuities.
- *  - The first derivative is zero at -5 and 5 to prevent discontinuities of
- *    that derivative.
- * 
- *  */
-static inline genome_f4_t sigmoid(genome_f4_t t) {
-    genome_f4_t poly;
-    genome_f4_t mux1;
-    genome_f4_t mux2;
-    
-    /* compute polynomial:
-     *      poly(t) =  -0.002 * t^3 + 0.15 * t + 0.5
-     *              = (-0.002 * t^2 + 0.15) * t + 0.5 */
-    poly = (_mm_set1_ps(-0.002) * t*t + _mm_set1_ps(0.15)) * t + _mm_set1_ps(0.5);
-    
-    /* select poly if -5 < t < 5, 0 if t < -5, 1 otherwise (t > 5) */
-    mux1 = mux_if_less(t, _mm_set1_ps(-5.0), _mm_set1_ps(0.0), poly);
-    mux2 = mux_if_less(t, _mm_set1_ps( 5.0), mux1, _mm_set1_ps(1.0));
-            
-    return mux2;
+/* Activation function of a hidden neuron (GENOME_SIGMOID, GENOME_GAUSSIAN or
+ * GENOME_RELU) */
+static inline genome_f4_t activation(int type, genome_f4_t t) {
+    switch(type) {
+    case GENOME_SIGMOID:
+        return sigmoid(t);
+    case GENOME_GAUSSIAN:
+        return gaussian(t);
+    default:
+        return relu(t);
+    }
 }
 
-/* Piecewise polynomial approximation of a gaussian-like curve
- * 
- * The value of the function is zero for arguments under -5 and over 5. Between
- * -5 and 0 the value of the function is the value of a degree 3 polynomial,
- * whereas between 0 and 5, it is the value of that same polynomial computed on
- * the inverse of the argument (i.e. p(-x)). The coefficients of the polynomial
- * have been computed with the following constraints in mind:
- * 
- *  - The polynomial has value 0 at -5 and 1 at 0 so as not to have
- *    discontinuities.
- *  - The first derivative is zero at -5 and 0 to prevent discontinuities of
- *    that derivative. 
-
- *  */
-static inline genome_f4_t gaussian(genome_f4_t t) {
-    genome_f4_t a;
-    genome_f4_t poly;
+static inline int16_t fixed_quantize(float value, int bits) {
+    float scaled;
     
-    /* select coefficient: a = -0.016 if t < 0, 0.016 otherwise */
-    a = mux_if_less(t, _mm_set1_ps(0.0), _mm_set1_ps(-0.016), _mm_set1_ps(0.016));
+    scaled = value * (float)(1 << bits);
     
-   /* compute polynomial:
-     *      poly(t) =  +/-0.016 * t^3 - 0.12 * t^2 + 1.0
-     *              =         a * t^3 - 0.12 * t^2 + 1.0
-     *              =        (a * t - 0.12) * t^2 + 1.0 */
-    poly = (a * t - _mm_set1_ps(0.12)) * t*t + _mm_set1_ps(1.0);
+    if(scaled > 32767.0) {
+        return 32767;
+    }
     
-    /* select poly if -5 < t < 5, 0 otherwise */
-    return mux_if_between(t, _mm_set1_ps(-5.0), _mm_set1_ps(5.0), poly, _mm_set1_ps(0.0));
+    if(scaled < -32768.0) {
+        return -32768;
+    }
+    
+    return (int16_t)lrintf(scaled);
 }
 
-bool brain_control_init(brain_control_t *control) {
-    control->left_speed  = 0.0;
-    control->right_speed = 0.0;
+/* Add to acc the sum of products of the weights of the recurrent inputs of a
+ * gene with the activations of the previous step of a layer of genes genes */
+static inline genome_f4_t recurrent_sum(genome_f4_t acc, const gene_chunk_t *weight, const gene_chunk_t *previous, int genes) {
+    const float *activations = (const float *)previous;
+    int          idx;
     
-    return true;
+    for(idx = 0; idx < 4 * genes; ++idx) {
+        acc += weight[idx].v * _mm_load1_ps(&activations[idx]);
+    }
+
+    return acc;
+}
+
+static inline void save_state(gene_chunk_t *state, const gene_chunk_t *hidden_layer, int genes) {
+    int idy;
+    
+    for(idy = 0; idy < genes; ++idy) {
+        state[idy].v = hidden_layer[idy].v;
+    }
 }
 
-void brain_control_compute(brain_control_t * restrict control, const genome_t * restrict genome, const stimuli_t * restrict stimuli) {
+/* Computation of the brain for a topology with the specified number of hidden
+ * layers and of genes in each of these layers, using the activation functions
+ * of the hidden layers in layer. When these arguments are constants, the compiler
+ * computes all chunk offsets at compile time and fully unrolls the loops. The
+ * kernels defined below with BRAIN_KERNEL() make use of this to provide
+ * specialized versions of this function for common topologies, which are all
+ * feedforward (recurrent is false). When recurrent is true, the hidden layers
+ * flagged as recurrent also take as inputs their own activations of the
+ * previous step, which are kept in state. */
+static inline __attribute__ ((always_inline)) void compute(
+        brain_control_t   * restrict control,
+        const brain_compiled_t * restrict compiled,
+        const stimuli_t   * restrict stimuli,
+        brain_state_t     * restrict state,
+        const genome_layer_t        *layer,
+        bool                         recurrent,
+        int                          layers,
+        int                          genes0,
+        int                          genes1,
+        int                          genes2) {
+    
     const gene_chunk_t *weight;
     const float        *hidden;
-    gene_chunk_t        hidden_layer[GENOME_HIDDEN_GENES];
+    genome_f4_t         last;
+    gene_chunk_t        hidden_layer[2][GENOME_MAX_GENES];
     gene_chunk_t        input[GENOME_INPUT_COUNT];
     gene_chunk_t        acc;
-    int                 idx, idy;
+    const int           genes[GENOME_MAX_LAYERS] = {genes0, genes1, genes2};
+    int                 inputs;
+    int                 offset;
+    int                 idx, idy, idl;
     
     input[0].v = _mm_load1_ps(&stimuli->food_intensity);
     input[1].v = _mm_load1_ps(&stimuli->food_angle);
@@ -150,37 +136,564 @@ void brain_control_compute(brain_control_t * restrict control, const genome_t *
     input[6].v = _mm_load1_ps(&stimuli->food_odour);
     input[7].v = _mm_load1_ps(&stimuli->danger_odour);
 
-    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
+    offset = 0;
+    
+    for(idy = 0; idy < genes[0]; ++idy) {
         /* chunk 0 is bias, weight * 1 = weight */
-        acc.v  =  genome->hidden[idy].chunk[0].v;
-        weight = &genome->hidden[idy].chunk[1];
+        acc.v  =  compiled->chunk[offset].v;
+        weight = &compiled->chunk[offset + 1];
         
         for(idx = 0; idx < GENOME_INPUT_COUNT; ++idx) {
             acc.v += weight[idx].v * input[idx].v;
         }
         
-        if(idy < GENOME_SIGMOID_GENES) {
-            hidden_layer[idy].v = gaussian(acc.v);
+        offset += GENOME_HIDDEN_WEIGHTS;
+        
+        if(recurrent && layer[0].recurrent) {
+            acc.v   = recurrent_sum(acc.v, &weight[GENOME_INPUT_COUNT], state->hidden[0], genes[0]);
+            offset += 4 * genes[0];
         }
-        else if(idy < GENOME_SIGMOID_GENES + GENOME_GAUSSIAN_GENES) {
-            hidden_layer[idy].v = sigmoid(acc.v);
+        
+        hidden_layer[0][idy].v = activation(layer[0].activation[idy], acc.v);
+    }
+    
+    if(recurrent && layer[0].recurrent) {
+        save_state(state->hidden[0], hidden_layer[0], genes[0]);
+    }
+    
+    for(idl = 1; idl < layers; ++idl) {
+        inputs = 4 * genes[idl - 1];
+        hidden = (float *)hidden_layer[(idl - 1) % 2];
+        
+        for(idy = 0; idy < genes[idl]; ++idy) {
+            acc.v  =  compiled->chunk[offset].v;
+            weight = &compiled->chunk[offset + 1];
+            
+            for(idx = 0; idx < inputs; ++idx) {
+                acc.v += weight[idx].v * _mm_load1_ps(&hidden[idx]);
+            }
+            
+            offset += inputs + 1;
+            
+            if(recurrent && layer[idl].recurrent) {
+                acc.v   = recurrent_sum(acc.v, &weight[inputs], state->hidden[idl], genes[idl]);
+                offset += 4 * genes[idl];
+            }
+            
+            hidden_layer[idl % 2][idy].v = activation(layer[idl].activation[idy], acc.v);
         }
-        else {
-            hidden_layer[idy].v = relu(acc.v);
+        
+        if(recurrent && layer[idl].recurrent) {
+            save_state(state->hidden[idl], hidden_layer[idl % 2], genes[idl]);
         }
     }
     
-    /* chunk 0 is bias */
-    acc.v  =  genome->output.chunk[0].v;
-    weight = &genome->output.chunk[1];
-    hidden = (float *)hidden_layer;
+    /* Output layer, packed by brain_compile(): chunk 0 is bias, then each chunk
+     * holds the weights of two inputs (see brain_compiled_t). The lower half
+     * of the accumulator sums the products of the even inputs and the upper
+     * half those of the odd inputs. */
+    acc.v  =  compiled->chunk[offset].v;
+    weight = &compiled->chunk[offset + 1];
     
-    for(idx = 0; idx < GENOME_HIDDEN_COUNT; ++idx) {
-        acc.v += weight[idx].v * _mm_load1_ps(&hidden[idx]);
+    for(idy = 0; idy < genes[layers - 1]; ++idy) {
+        last   = hidden_layer[(layers - 1) % 2][idy].v;
+        acc.v += weight[2 * idy].v     * _mm_unpacklo_ps(last, last);
+        acc.v += weight[2 * idy + 1].v * _mm_unpackhi_ps(last, last);
     }
     
-    acc.v = sigmoid(acc.v);
+    acc.v = sigmoid(acc.v + _mm_movehl_ps(acc.v, acc.v));
     
     control->left_speed  = acc.f[0];
     control->right_speed = acc.f[1];
 }
+
+/* Generic kernel, for topologies without a specialized one */
+static void kernel_generic(brain_control_t * restrict control, const brain_compiled_t * restrict compiled, const stimuli_t * restrict stimuli, brain_state_t * restrict state) {
+    const genome_topology_t *topology = genome_get_topology();
+    
+    compute(
+        control,
+        compiled,
+        stimuli,
+        state,
+        topology->layer,
+        topology->recurrent,
+        topology->layers,
+        topology->layer[0].genes,
+        topology->layer[1].genes,
+        topology->layer[2].genes);
+}
+
+/* Specialized kernel for layers hidden layers of genes0, genes1 and genes2
+ * genes respectively (unused ones zero) */
+#define BRAIN_KERNEL(layers, genes0, genes1, genes2) \
+    static void kernel_##layers##_##genes0##_##genes1##_##genes2( \
+            brain_control_t * restrict control, \
+            const brain_compiled_t * restrict compiled, \
+            const stimuli_t * restrict stimuli, \
+            brain_state_t * restrict state) { \
+        compute(control, compiled, stimuli, state, genome_get_topology()->layer, false, layers, genes0, genes1, genes2); \
+    }
+
+#define BRAIN_KERNEL_ENTRY(layers, genes0, genes1, genes2) \
+    {layers, {genes0, genes1, genes2}, kernel_##layers##_##genes0##_##genes1##_##genes2}
+
+BRAIN_KERNEL(1, 1, 0, 0)
+BRAIN_KERNEL(1, 2, 0, 0)
+BRAIN_KERNEL(1, 3, 0, 0)
+BRAIN_KERNEL(1, 4, 0, 0)
+BRAIN_KERNEL(2, 1, 1, 0)
+BRAIN_KERNEL(2, 2, 1, 0)
+BRAIN_KERNEL(2, 2, 2, 0)
+BRAIN_KERNEL(2, 4, 2, 0)
+BRAIN_KERNEL(2, 4, 4, 0)
+BRAIN_KERNEL(3, 2, 2, 2)
+BRAIN_KERNEL(3, 4, 4, 4)
+
+static const struct {
+    int             layers;
+    int             genes[GENOME_MAX_LAYERS];
+    brain_kernel_t *kernel;
+} kernels[] = {
+    BRAIN_KERNEL_ENTRY(1, 1, 0, 0),
+    BRAIN_KERNEL_ENTRY(1, 2, 0, 0),
+    BRAIN_KERNEL_ENTRY(1, 3, 0, 0),
+    BRAIN_KERNEL_ENTRY(1, 4, 0, 0),
+    BRAIN_KERNEL_ENTRY(2, 1, 1, 0),
+    BRAIN_KERNEL_ENTRY(2, 2, 1, 0),
+    BRAIN_KERNEL_ENTRY(2, 2, 2, 0),
+    BRAIN_KERNEL_ENTRY(2, 4, 2, 0),
+    BRAIN_KERNEL_ENTRY(2, 4, 4, 0),
+    BRAIN_KERNEL_ENTRY(3, 2, 2, 2),
+    BRAIN_KERNEL_ENTRY(3, 4, 4, 4)
+};
+
+/* Hidden layer of the default topology */
+static const genome_layer_t default_layer[1] = {
+    {
+        .genes      = GENOME_HIDDEN_GENES,
+        .inputs     = GENOME_INPUT_COUNT,
+        .weights    = GENOME_HIDDEN_WEIGHTS,
+        .offset     = 0,
+        .recurrent  = false,
+        .activation = {
+            GENOME_DEFAULT_ACTIVATION(0),
+            GENOME_DEFAULT_ACTIVATION(1),
+            GENOME_DEFAULT_ACTIVATION(2),
+            GENOME_DEFAULT_ACTIVATION(3) }
+    }
+};
+
+/* Default kernel, specialized for the default topology down to the activation
+ * functions */
+static void kernel_default(brain_control_t * restrict control, const brain_compiled_t * restrict compiled, const stimuli_t * restrict stimuli, brain_state_t * restrict state) {
+    compute(control, compiled, stimuli, state, default_layer, false, 1, GENOME_HIDDEN_GENES, 0, 0);
+}
+
+static brain_kernel_t *kernel = kernel_default;
+
+/* Select the topology of the brain of all critters and the kernel that
+ * computes it: a specialized kernel if there is one for this topology, the
+ * generic one otherwise (including for all recurrent topologies). Must be
+ * called before any genome is created. */
+void brain_set_topology(const genome_topology_t *topology) {
+    int idx, idl;
+    
+    genome_set_topology(topology);
+    
+    if(topology->recurrent) {
+        kernel = kernel_generic;
+        return;
+    }
+    
+    if(topology->layers == 1 && topology->layer[0].genes == GENOME_HIDDEN_GENES) {
+        for(idx = 0; idx < GENOME_HIDDEN_GENES; ++idx) {
+            if(topology->layer[0].activation[idx] != default_layer[0].activation[idx]) {
+                break;
+            }
+        }
+        
+        if(idx == GENOME_HIDDEN_GENES) {
+            kernel = kernel_default;
+            return;
+        }
+    }
+    
+    kernel = kernel_generic;
+    
+    for(idx = 0; idx < sizeof(kernels) / sizeof(kernels[0]); ++idx) {
+        if(kernels[idx].layers != topology->layers) {
+            continue;
+        }
+        
+        for(idl = 0; idl < topology->layers; ++idl) {
+            if(kernels[idx].genes[idl] != topology->layer[idl].genes) {
+                break;
+            }
+        }
+        
+        if(idl == topology->layers) {
+            kernel = kernels[idx].kernel;
+            break;
+        }
+    }
+}
+
+/* The reduced precision computation only supports topologies with the same
+ * shape as the default one, i.e. a single feedforward hidden layer of
+ * GENOME_HIDDEN_COUNT neurons. */
+bool brain_fixed_supported(void) {
+    const genome_topology_t *topology = genome_get_topology();
+    
+    return topology->layers == 1 && topology->layer[0].genes == GENOME_HIDDEN_GENES && !topology->recurrent;
+}
+
+/* Stimuli, converted to fixed point and packed by pairs of inputs for
+ * _mm_madd_epi16(), each pair copied four times, followed by the bias paired
+ * with zero. The layout of stimuli_t matches the order of the inputs. */
+static inline void fixed_stimuli(__m128i input[BRAIN_FIXED_HIDDEN_PAIRS], const stimuli_t * restrict stimuli) {
+    genome_f4_t scale;
+    __m128i     packed;
+    
+    scale   = _mm_set1_ps((float)(1 << FIXED_INPUT_BITS));
+    packed  = _mm_packs_epi32(
+                _mm_cvtps_epi32(_mm_load_ps(&stimuli->food_intensity) * scale),
+                _mm_cvtps_epi32(_mm_load_ps(&stimuli->wall_intensity) * scale) );
+    
+    /* each 32-bit element holds a pair of inputs, copy each pair four times */
+    input[0] = _mm_shuffle_epi32(packed, 0x00);
+    input[1] = _mm_shuffle_epi32(packed, 0x55);
+    input[2] = _mm_shuffle_epi32(packed, 0xaa);
+    input[3] = _mm_shuffle_epi32(packed, 0xff);
+    input[4] = _mm_set1_epi32(1 << FIXED_INPUT_BITS);   /* bias, paired with zero */
+}
+
+/* Hidden layer activations, converted to fixed point and packed by pairs like
+ * the stimuli (see fixed_stimuli()) */
+static inline void fixed_hidden_layer(__m128i hidden[BRAIN_FIXED_OUTPUT_PAIRS], const gene_chunk_t hidden_layer[GENOME_HIDDEN_GENES]) {
+    genome_f4_t scale;
+    __m128i     packed;
+    int         idy;
+    
+    scale = _mm_set1_ps((float)(1 << FIXED_HIDDEN_BITS));
+    
+    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
+        packed = _mm_cvtps_epi32(hidden_layer[idy].v * scale);
+        packed = _mm_packs_epi32(packed, packed);
+        
+        hidden[2 * idy]     = _mm_shuffle_epi32(packed, 0x00);
+        hidden[2 * idy + 1] = _mm_shuffle_epi32(packed, 0x55);
+    }
+    
+    hidden[GENOME_HIDDEN_COUNT / 2] = _mm_set1_epi32(1 << FIXED_HIDDEN_BITS);
+}
+
+/* Sum of products of two pairs of 8-bit weights (sign-extended to 16 bits) and
+ * the corresponding two pairs of 16-bit inputs */
+static inline __m128i int8_madd(brain_b16_t weights, __m128i input0, __m128i input1) {
+    __m128i low;
+    __m128i high;
+    
+    low  = _mm_srai_epi16(_mm_unpacklo_epi8((__m128i)weights, (__m128i)weights), 8);
+    high = _mm_srai_epi16(_mm_unpackhi_epi8((__m128i)weights, (__m128i)weights), 8);
+    
+    return _mm_add_epi32(_mm_madd_epi16(low, input0), _mm_madd_epi16(high, input1));
+}
+
+/* Quantize the weights of count neurons (up to four) with the specified number
+ * of inputs (bias excluded) to 8 bits, with the bias in the first element of
+ * the last pair, as in brain_fixed_quantize(). */
+static void int8_quantize_neurons(brain_b16_t *vectors, int vector_count, genome_f4_t *scale, const gene_chunk_t *bias, int inputs, int count) {
+    gene_chunk_t    neuron_scale;
+    float           weight;
+    float           max;
+    int             neuron;
+    int             idx;
+    
+    for(idx = 0; idx < vector_count; ++idx) {
+        vectors[idx] = (brain_b16_t)_mm_setzero_si128();
+    }
+    
+    for(neuron = 0; neuron < 4; ++neuron) {
+        neuron_scale.f[neuron] = 0.0;
+    }
+    
+    for(neuron = 0; neuron < count; ++neuron) {
+        max = fabsf(bias[0].f[neuron]);
+        
+        for(idx = 1; idx <= inputs; ++idx) {
+            max = fmaxf(max, fabsf(bias[idx].f[neuron]));
+        }
+        
+        if(max == 0.0) {
+            continue;
+        }
+        
+        neuron_scale.f[neuron] = max / 127.0;
+        
+        /* element idx of the pairs is input idx, input inputs is the bias */
+        for(idx = 0; idx <= inputs; ++idx) {
+            if(idx < inputs) {
+                weight = bias[idx + 1].f[neuron];
+            }
+            else {
+                weight = bias[0].f[neuron];
+            }
+            
+            vectors[idx / 4][8 * (idx / 2 % 2) + 2 * neuron + idx % 2] = (int8_t)lrintf(weight / neuron_scale.f[neuron]);
+        }
+    }
+    
+    *scale = neuron_scale.v;
+}
+
+bool brain_control_init(brain_control_t *control) {
+    control->left_speed  = 0.0;
+    control->right_speed = 0.0;
+    
+    return true;
+}
+
+void brain_state_init(brain_state_t *state) {
+    int idx, idy;
+    
+    for(idy = 0; idy < GENOME_MAX_LAYERS; ++idy) {
+        for(idx = 0; idx < GENOME_MAX_GENES; ++idx) {
+            state->hidden[idy][idx].v = _mm_setzero_ps();
+        }
+    }
+}
+
+/* Size of a brain_compiled_t of which only the chunks used by the selected
+ * topology are allocated */
+size_t brain_compiled_size(void) {
+    const genome_topology_t *topology;
+    
+    topology = genome_get_topology();
+    
+    return offsetof(brain_compiled_t, chunk) + (topology->output_offset + 1 + topology->output_inputs / 2) * sizeof(gene_chunk_t);
+}
+
+/* Convert the weights of a genome to the layout used by the brain
+ * computation (see brain_compiled_t). */
+void brain_compile(brain_compiled_t * restrict compiled, const genome_t * restrict genome) {
+    const genome_topology_t *topology;
+    const gene_chunk_t      *output;
+    gene_chunk_t            *packed;
+    int                      idx;
+    
+    topology = genome_get_topology();
+    
+    /* hidden layers: same layout */
+    for(idx = 0; idx < topology->output_offset; ++idx) {
+        compiled->chunk[idx].v = genome->chunk[idx].v;
+    }
+    
+    output = genome_output(genome, topology);
+    packed = &compiled->chunk[topology->output_offset];
+    
+    packed[0].v = _mm_movelh_ps(output[0].v, _mm_setzero_ps());
+    
+    for(idx = 0; idx < topology->output_inputs / 2; ++idx) {
+        packed[idx + 1].v = _mm_movelh_ps(output[2 * idx + 1].v, output[2 * idx + 2].v);
+    }
+}
+
+void brain_control_compute(brain_control_t * restrict control, const brain_compiled_t * restrict compiled, const stimuli_t * restrict stimuli, brain_state_t * restrict state) {
+    kernel(control, compiled, stimuli, state);
+}
+
+/* Compute the brains of a batch of critters in one pass. The kernel is
+ * selected once for the whole batch and the weights and state of the next
+ * critter are prefetched while computing the current one. */
+void brain_control_compute_batch(const brain_job_t *jobs, int n) {
+    brain_kernel_t  *batch_kernel;
+    int              idx;
+    
+    batch_kernel = kernel;
+    
+    for(idx = 0; idx < n; ++idx) {
+        if(idx + 1 < n) {
+            _mm_prefetch((const char *)jobs[idx + 1].compiled, _MM_HINT_T0);
+            _mm_prefetch((const char *)jobs[idx + 1].state,  _MM_HINT_T0);
+        }
+        
+        batch_kernel(jobs[idx].control, jobs[idx].compiled, jobs[idx].stimuli, jobs[idx].state);
+    }
+}
+
+void brain_fixed_quantize(brain_fixed_t * restrict fixed, const genome_t * restrict genome) {
+    const genome_topology_t *topology;
+    const gene_chunk_t      *bias;
+    const gene_chunk_t      *weight;
+    int                      idx, idy;
+    int                      neuron;
+    
+    if(!brain_fixed_supported()) {
+        return;
+    }
+    
+    topology = genome_get_topology();
+    
+    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
+        /* chunk 0 is bias, paired with zero in the last pair */
+        bias   = genome_hidden(genome, topology, 0, idy);
+        weight = &bias[1];
+        
+        for(idx = 0; idx < GENOME_INPUT_COUNT / 2; ++idx) {
+            for(neuron = 0; neuron < 4; ++neuron) {
+                fixed->hidden[idy][idx][2 * neuron]     = fixed_quantize(weight[2 * idx].f[neuron],     FIXED_WEIGHT_BITS);
+                fixed->hidden[idy][idx][2 * neuron + 1] = fixed_quantize(weight[2 * idx + 1].f[neuron], FIXED_WEIGHT_BITS);
+            }
+        }
+        
+        for(neuron = 0; neuron < 4; ++neuron) {
+            fixed->hidden[idy][idx][2 * neuron]     = fixed_quantize(bias->f[neuron], FIXED_WEIGHT_BITS);
+            fixed->hidden[idy][idx][2 * neuron + 1] = 0;
+        }
+    }
+    
+    bias   = genome_output(genome, topology);
+    weight = &bias[1];
+    
+    for(idx = 0; idx < BRAIN_FIXED_OUTPUT_PAIRS; ++idx) {
+        fixed->output[idx] = (brain_s8_t)_mm_setzero_si128();
+        
+        for(neuron = 0; neuron < GENOME_OUTPUT_COUNT; ++neuron) {
+            if(idx < GENOME_HIDDEN_COUNT / 2) {
+                fixed->output[idx][2 * neuron]      = fixed_quantize(weight[2 * idx].f[neuron],     FIXED_WEIGHT_BITS);
+                fixed->output[idx][2 * neuron + 1]  = fixed_quantize(weight[2 * idx + 1].f[neuron], FIXED_WEIGHT_BITS);
+            }
+            else {
+                fixed->output[idx][2 * neuron]      = fixed_quantize(bias->f[neuron], FIXED_WEIGHT_BITS);
+            }
+        }
+    }
+}
+
+/* Same computation as brain_control_compute() but with the weights, the
+ * stimuli and the hidden layer activations as 16-bit fixed-point values. The
+ * sums of products are computed with the SSE2 _mm_madd_epi16() intrinsic
+ * (pmaddwd instruction), which does eight multiplications at once instead of
+ * four. Activation functions are still computed in floating point. Only
+ * supported if brain_fixed_supported() returns true. */
+void brain_control_compute_fixed(brain_control_t * restrict control, const brain_fixed_t * restrict fixed, const stimuli_t * restrict stimuli) {
+    const genome_topology_t *topology = genome_get_topology();
+    gene_chunk_t    hidden_layer[GENOME_HIDDEN_GENES];
+    gene_chunk_t    out;
+    __m128i         input[BRAIN_FIXED_HIDDEN_PAIRS];
+    __m128i         hidden[BRAIN_FIXED_OUTPUT_PAIRS];
+    __m128i         acc;
+    genome_f4_t     scale;
+    int             idx, idy;
+    
+    fixed_stimuli(input, stimuli);
+    
+    scale = _mm_set1_ps(1.0 / (float)(1 << (FIXED_WEIGHT_BITS + FIXED_INPUT_BITS)));
+    
+    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
+        acc = _mm_setzero_si128();
+        
+        for(idx = 0; idx < BRAIN_FIXED_HIDDEN_PAIRS; ++idx) {
+            acc = _mm_add_epi32(acc, _mm_madd_epi16((__m128i)fixed->hidden[idy][idx], input[idx]));
+        }
+        
+        hidden_layer[idy].v = activation(topology->layer[0].activation[idy], _mm_cvtepi32_ps(acc) * scale);
+    }
+    
+    fixed_hidden_layer(hidden, hidden_layer);
+    
+    acc = _mm_setzero_si128();
+    
+    for(idx = 0; idx < BRAIN_FIXED_OUTPUT_PAIRS; ++idx) {
+        acc = _mm_add_epi32(acc, _mm_madd_epi16((__m128i)fixed->output[idx], hidden[idx]));
+    }
+    
+    scale = _mm_set1_ps(1.0 / (float)(1 << (FIXED_WEIGHT_BITS + FIXED_HIDDEN_BITS)));
+    out.v = sigmoid(_mm_cvtepi32_ps(acc) * scale);
+    
+    control->left_speed  = out.f[0];
+    control->right_speed = out.f[1];
+}
+
+void brain_int8_quantize(brain_int8_t * restrict quantized, const genome_t * restrict genome) {
+    const genome_topology_t *topology;
+    int                      idy;
+    
+    if(!brain_fixed_supported()) {
+        return;
+    }
+    
+    topology = genome_get_topology();
+    
+    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
+        int8_quantize_neurons(
+                quantized->hidden[idy],
+                BRAIN_INT8_HIDDEN_VECTORS,
+                &quantized->hidden_scale[idy],
+                genome_hidden(genome, topology, 0, idy),
+                GENOME_INPUT_COUNT,
+                4);
+    }
+    
+    int8_quantize_neurons(
+            quantized->output,
+            BRAIN_INT8_OUTPUT_VECTORS,
+            &quantized->output_scale,
+            genome_output(genome, topology),
+            GENOME_HIDDEN_COUNT,
+            GENOME_OUTPUT_COUNT);
+}
+
+/* Same computation as brain_control_compute_fixed() but with 8-bit weights,
+ * each neuron with its own scale (see brain_int8_t). SSE2 has no instruction
+ * that multiplies 8-bit values (pmaddubsw requires SSSE3), so the weights are
+ * sign-extended to 16 bits and multiplied with _mm_madd_epi16(). Only
+ * supported if brain_fixed_supported() returns true. */
+void brain_control_compute_int8(brain_control_t * restrict control, const brain_int8_t * restrict quantized, const stimuli_t * restrict stimuli) {
+    const genome_topology_t *topology = genome_get_topology();
+    gene_chunk_t    hidden_layer[GENOME_HIDDEN_GENES];
+    gene_chunk_t    out;
+    __m128i         input[2 * BRAIN_INT8_HIDDEN_VECTORS];
+    __m128i         hidden[2 * BRAIN_INT8_OUTPUT_VECTORS];
+    __m128i         acc;
+    genome_f4_t     scale;
+    int             idx, idy;
+    
+    fixed_stimuli(input, stimuli);
+    
+    /* padding: the weights of the unused pair are zero */
+    for(idx = BRAIN_FIXED_HIDDEN_PAIRS; idx < 2 * BRAIN_INT8_HIDDEN_VECTORS; ++idx) {
+        input[idx] = _mm_setzero_si128();
+    }
+    
+    scale = _mm_set1_ps(1.0 / (float)(1 << FIXED_INPUT_BITS));
+    
+    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
+        acc = _mm_setzero_si128();
+        
+        for(idx = 0; idx < BRAIN_INT8_HIDDEN_VECTORS; ++idx) {
+            acc = _mm_add_epi32(acc, int8_madd(quantized->hidden[idy][idx], input[2 * idx], input[2 * idx + 1]));
+        }
+        
+        hidden_layer[idy].v = activation(topology->layer[0].activation[idy], _mm_cvtepi32_ps(acc) * quantized->hidden_scale[idy] * scale);
+    }
+    
+    fixed_hidden_layer(hidden, hidden_layer);
+    
+    for(idx = BRAIN_FIXED_OUTPUT_PAIRS; idx < 2 * BRAIN_INT8_OUTPUT_VECTORS; ++idx) {
+        hidden[idx] = _mm_setzero_si128();
+    }
+    
+    acc = _mm_setzero_si128();
+    
+    for(idx = 0; idx < BRAIN_INT8_OUTPUT_VECTORS; ++idx) {
+        acc = _mm_add_epi32(acc, int8_madd(quantized->output[idx], hidden[2 * idx], hidden[2 * idx + 1]));
+    }
+    
+    scale = _mm_set1_ps(1.0 / (float)(1 << FIXED_HIDDEN_BITS));
+    out.v = sigmoid(_mm_cvtepi32_ps(acc) * quantized->output_scale * scale);
+    
+    control->left_speed  = out.f[0];
+    control->right_speed = out.f[1];
+}
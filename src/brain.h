@@ -30,19 +30,129 @@
 #define CRITTERS_BRAIN_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "genome.h"
 #include "stimuli.h"
 
+/* Number of pairs of inputs of a hidden neuron (including the bias) */
+#define BRAIN_FIXED_HIDDEN_PAIRS    (GENOME_INPUT_COUNT / 2 + 1)
+
+/* Number of pairs of inputs of an output neuron (including the bias) */
+#define BRAIN_FIXED_OUTPUT_PAIRS    (GENOME_HIDDEN_COUNT / 2 + 1)
+
+/* Number of chunks of the compiled weights for the largest topology: the
+ * output layer takes half as many chunks as in the genome (bias excluded). */
+#define BRAIN_COMPILED_CHUNKS       (GENOME_MAX_CHUNKS - 2 * GENOME_MAX_GENES)
+
+/* Number of vectors of 8-bit weights of a hidden gene, two pairs per vector */
+#define BRAIN_INT8_HIDDEN_VECTORS   ((BRAIN_FIXED_HIDDEN_PAIRS + 1) / 2)
+
+/* Number of vectors of 8-bit weights of the output layer */
+#define BRAIN_INT8_OUTPUT_VECTORS   ((BRAIN_FIXED_OUTPUT_PAIRS + 1) / 2)
+
 typedef struct brain_control_t brain_control_t;
 
+typedef struct brain_fixed_t brain_fixed_t;
+
+typedef struct brain_int8_t brain_int8_t;
+
+typedef struct brain_state_t brain_state_t;
+
+typedef struct brain_compiled_t brain_compiled_t;
+
+typedef struct brain_job_t brain_job_t;
+
+/* Function that computes the brain for a given topology (see brain_set_topology()) */
+typedef void brain_kernel_t(brain_control_t * restrict control, const brain_compiled_t * restrict compiled, const stimuli_t * restrict stimuli, brain_state_t * restrict state);
+
+/* A vector of eight 16-bit integer values */
+typedef int16_t brain_s8_t __attribute__ ((vector_size (16)));
+
+/* A vector of sixteen 8-bit integer values */
+typedef int8_t brain_b16_t __attribute__ ((vector_size (16)));
+
 struct brain_control_t {
     float       left_speed;
     float       right_speed;
 };
 
+/* Weights of a genome converted to 16-bit fixed-point values for the reduced
+ * precision computation (see brain_control_compute_fixed()).
+ * 
+ * Each vector holds the weights of two inputs for four neurons (hidden layer)
+ * or two neurons (output layer, upper half unused), interleaved as follows:
+ * 
+ *  neuron 0 input i, neuron 0 input i + 1, neuron 1 input i, ... */
+struct brain_fixed_t {
+    brain_s8_t  hidden[GENOME_HIDDEN_GENES][BRAIN_FIXED_HIDDEN_PAIRS];
+    brain_s8_t  output[BRAIN_FIXED_OUTPUT_PAIRS];
+} __attribute__ ((aligned (16)));
+
+/* Weights of a genome converted to 8-bit integer values for the quantized
+ * computation (see brain_control_compute_int8()). Each neuron has its own
+ * scale, chosen so its largest weight (in absolute value) maps to 127, and
+ * the weight is the 8-bit value times the scale.
+ * 
+ * The weights are interleaved as in brain_fixed_t, with two consecutive pairs
+ * of inputs in each vector (the first one in the lower half). */
+struct brain_int8_t {
+    brain_b16_t     hidden[GENOME_HIDDEN_GENES][BRAIN_INT8_HIDDEN_VECTORS];
+    brain_b16_t     output[BRAIN_INT8_OUTPUT_VECTORS];
+    genome_f4_t     hidden_scale[GENOME_HIDDEN_GENES];
+    genome_f4_t     output_scale;
+} __attribute__ ((aligned (16)));
+
+/* Activations of the recurrent hidden layers, carried from one step to the
+ * next. Aligned on a cache line so the state of a critter never shares one
+ * with other data. */
+struct brain_state_t {
+    gene_chunk_t    hidden[GENOME_MAX_LAYERS][GENOME_MAX_GENES];
+} __attribute__ ((aligned (64)));
+
+/* Weights of a genome in the layout used by the brain computation (see
+ * brain_compile()). The hidden layers have the same layout as in the genome.
+ * In the output layer, where the genome only uses the lower half of each
+ * chunk, the weights of two consecutive inputs are packed in each chunk:
+ * 
+ *  neuron 0 input i, neuron 1 input i, neuron 0 input i + 1, neuron 1 input i + 1
+ * 
+ * The bias chunk of the output layer stays as is (upper half zero). */
+struct brain_compiled_t {
+    gene_chunk_t    chunk[BRAIN_COMPILED_CHUNKS];
+} __attribute__ ((aligned (64)));
+
+/* Brain computation of one critter in a batch (see brain_control_compute_batch()) */
+struct brain_job_t {
+    brain_control_t         *control;
+    const brain_compiled_t  *compiled;
+    const stimuli_t         *stimuli;
+    brain_state_t           *state;
+};
+
 bool brain_control_init(brain_control_t *control);
 
-void brain_control_compute(brain_control_t * restrict control, const genome_t * restrict genome, const stimuli_t * restrict stimuli);
+void brain_state_init(brain_state_t *state);
+
+size_t brain_compiled_size(void);
+
+void brain_compile(brain_compiled_t * restrict compiled, const genome_t * restrict genome);
+
+void brain_control_compute(brain_control_t * restrict control, const brain_compiled_t * restrict compiled, const stimuli_t * restrict stimuli, brain_state_t * restrict state);
+
+void brain_control_compute_batch(const brain_job_t *jobs, int n);
+
+void brain_set_topology(const genome_topology_t *topology);
+
+bool brain_fixed_supported(void);
+
+void brain_fixed_quantize(brain_fixed_t * restrict fixed, const genome_t * restrict genome);
+
+void brain_control_compute_fixed(brain_control_t * restrict control, const brain_fixed_t * restrict fixed, const stimuli_t * restrict stimuli);
+
+void brain_int8_quantize(brain_int8_t * restrict quantized, const genome_t * restrict genome);
+
+void brain_control_compute_int8(brain_control_t * restrict control, const brain_int8_t * restrict quantized, const stimuli_t * restrict stimuli);
 
 
 #endif
@@ -29,12 +29,14 @@
 #include <quatre/macros.h>
 #include <quatre/tree.h>
 #include <errno.h>
+#include <float.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "breeder.h"
 #include "critter.h"
 #include "genome.h"
+#include "lineage.h"
 #include "scene.h"
 #include "util.h"
 
@@ -45,12 +47,35 @@
 
 #define FITNESS_FORMAT  "%10.3f"
 
+/* Number of slots in the fitness cache hash table. Must be a power of two
+ * larger than the population size. */
+#define FITNESS_CACHE_SIZE  512
+
+/* Number of times each critter is simulated for BREEDER_SIM_STEPS steps */
+#define SIMULATION_RUNS     (BREEDER_SCRIPTS > 0 ? BREEDER_SCRIPTS : 1)
+
+/* Total number of steps for which each critter is simulated */
+#define SIMULATION_STEPS    (SIMULATION_RUNS * BREEDER_SIM_STEPS)
+
+#define SCREEN_STEPS        (BREEDER_SCREEN_TIME * MILLISECONDS_PER_SECOND / BREEDER_TIME_STEP)
+
 typedef struct {
-    scene_t     *scene;
-    int          status;
-    pthread_t    thread;
-    critter_t   *critters_in;
-    critter_t   *critters_out;
+    scene_t                 *scene;
+    int                      status;
+    pthread_t                thread;
+    critter_t               *critters_in;
+    critter_t               *critters_out;
+    critter_t               *critters_hopeless;
+    const scene_script_t    *scripts;
+    float                    threshold;
+    int                      first_step;
+    int                      last_step;
+    long                     steps;
+    scene_snapshot_t        *snapshot;
+    pthread_mutex_t          snapshot_mutex;
+    bool                     snapshot_valid;
+    long                     scene_steps;
+    int64_t                  busy;
 } thread_state_t;
 
 struct breeder_t {
@@ -60,12 +85,91 @@ struct breeder_t {
     thread_state_t  *threads;
     pthread_mutex_t  mutex;
     pthread_t        loop_thread;
+    long             steps;
+    long             steps_saved;
+    int              reused;
+    critter_t       *critters_screened_out;
+    lineage_writer_t *lineage;
+    breeder_champions_t *champions;
+    long             generations;
+    long             genomes;
+    int64_t          lock_wait;
+    genome_t        *cache[FITNESS_CACHE_SIZE];
+    scene_script_t   scripts[SIMULATION_RUNS + 1];
 };
 
+static int64_t microseconds_now(void) {
+    struct timeval now;
+    
+    gettimeofday(&now, NULL);
+    
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
 static void tree_finalizer(void *param, void *genome) {
     genome_free(genome);
 }
 
+static inline float critter_fitness(const critter_t *critter) {
+    float fitness;
+    
+    fitness = BREEDER_FOOD_COST * critter->food_count + BREEDER_DANGER_COST * critter->danger_count;
+    
+    return fitness * (1.0 / SIMULATION_RUNS);
+}
+
+static void fitness_cache_clear(breeder_t *breeder) {
+    int idx;
+    
+    for(idx = 0; idx < FITNESS_CACHE_SIZE; ++idx) {
+        breeder->cache[idx] = NULL;
+    }
+}
+
+/* The fitness cache does not hold references to the genomes it contains, so
+ * it is only valid until the population from which it was built is cleared. */
+static void fitness_cache_add(breeder_t *breeder, genome_t *genome) {
+    int idx;
+    
+    idx = genome->hash % FITNESS_CACHE_SIZE;
+    
+    while(breeder->cache[idx] != NULL) {
+        if(genome_equal(breeder->cache[idx], genome)) {
+            return;
+        }
+        
+        idx = (idx + 1) % FITNESS_CACHE_SIZE;
+    }
+    
+    breeder->cache[idx] = genome;
+}
+
+static genome_t *fitness_cache_lookup(breeder_t *breeder, const genome_t *genome) {
+    int idx;
+    
+    idx = genome->hash % FITNESS_CACHE_SIZE;
+    
+    while(breeder->cache[idx] != NULL) {
+        if(genome_equal(breeder->cache[idx], genome)) {
+            return breeder->cache[idx];
+        }
+        
+        idx = (idx + 1) % FITNESS_CACHE_SIZE;
+    }
+    
+    return NULL;
+}
+
+/* A critter is hopeless if it cannot reach the survival threshold even if it
+ * gains points at BREEDER_EARLY_EXIT_RATE for the rest of the simulation. */
+static inline bool critter_is_hopeless(const critter_t *critter, float threshold, int steps_left) {
+    float time_left;
+    
+    time_left = (float)(steps_left * BREEDER_TIME_STEP) / (float)MILLISECONDS_PER_SECOND;
+    
+    return critter_fitness(critter) + BREEDER_EARLY_EXIT_RATE * time_left * (1.0 / SIMULATION_RUNS) < threshold;
+}
+
 breeder_t *breeder_new(int thread_n) {
     breeder_t        *breeder;
     genome_t         *genome;
@@ -96,7 +200,13 @@ breeder_t *breeder_new(int thread_n) {
         }
         
         for(idx = 0; idx < thread_n; ++idx) {
-            threads[idx].scene = scene_new();
+            threads[idx].scene      = scene_new();
+            threads[idx].scripts    = breeder->scripts;
+            threads[idx].snapshot   = NULL;
+            threads[idx].snapshot_valid = false;
+            threads[idx].critters_hopeless  = NULL;
+            threads[idx].scene_steps    = 0;
+            threads[idx].busy           = 0;
             
             if(threads[idx].scene == NULL) {
                 for(idy = 0; idy < idx; ++idy) {
@@ -106,14 +216,28 @@ breeder_t *breeder_new(int thread_n) {
                 qrt_tree_free(population, NULL, NULL);
                 free(threads);
                 free(breeder);
+                return NULL;
             }
+            
+            scene_set_precision(threads[idx].scene, BREEDER_PRECISION);
+            pthread_mutex_init(&threads[idx].snapshot_mutex, NULL);
         }
         
-        breeder->generation = 0;
-        breeder->thread_n   = thread_n;
-        breeder->threads    = threads;
-        breeder->population = population;
+        breeder->generation     = 0;
+        breeder->steps          = 0;
+        breeder->steps_saved    = 0;
+        breeder->reused         = 0;
+        breeder->critters_screened_out = NULL;
+        breeder->lineage        = NULL;
+        breeder->champions      = NULL;
+        breeder->generations    = 0;
+        breeder->genomes        = 0;
+        breeder->lock_wait      = 0;
+        breeder->thread_n       = thread_n;
+        breeder->threads        = threads;
+        breeder->population     = population;
         pthread_mutex_init(&breeder->mutex, NULL);
+        fitness_cache_clear(breeder);
         
         for(idx = 0; idx < BREEDER_POPULATION_SIZE; ++idx) {
             genome = genome_new();
@@ -134,44 +258,140 @@ void breeder_free(breeder_t *breeder) {
     if(breeder != NULL) {
         for(idx = 0; idx < breeder->thread_n; ++idx) {
             scene_free(breeder->threads[idx].scene);
+            scene_snapshot_free(breeder->threads[idx].snapshot);
+            pthread_mutex_destroy(&breeder->threads[idx].snapshot_mutex);
         }
         free(breeder->threads);
         pthread_mutex_destroy(&breeder->mutex);
         qrt_tree_free(breeder->population, tree_finalizer, NULL);
+        lineage_writer_free(breeder->lineage);
+        breeder_champions_free(breeder->champions);
     }
     
     free(breeder);
 }
 
+/* Stop recording the lineage after a write error */
+static void lineage_check(breeder_t *breeder, bool status) {
+    if(!status) {
+        fprintf(stderr, "Cannot write lineage file, lineage recording stopped\n");
+        lineage_writer_free(breeder->lineage);
+        breeder->lineage = NULL;
+    }
+}
+
+/* Remove hopeless critters from the scene and add them to the list of
+ * hopeless critters. Returns the number of critters that remain in the
+ * scene. */
+static int early_exit(thread_state_t *thread, int steps_left) {
+    critter_t   *critter;
+    critter_t   *next;
+    scene_t     *scene;
+    int          count;
+    
+    scene   = thread->scene;
+    critter = scene_first_critter(scene);
+    count   = 0;
+    
+    while(critter != NULL) {
+        next = scene_next_critter(scene, critter);
+        
+        if(critter_is_hopeless(critter, thread->threshold, steps_left)) {
+            scene_remove_critter(scene, critter);
+            
+            critter->next               = thread->critters_hopeless;
+            thread->critters_hopeless   = critter;
+        }
+        else {
+            ++count;
+        }
+        
+        critter = next;
+    }
+    
+    return count;
+}
+
+/* Publish a snapshot of the scene of the thread, unless snapshots are not
+ * enabled or the snapshot is being read, so this never waits. */
+static void publish_snapshot(thread_state_t *thread) {
+    scene_snapshot_t *snapshot;
+    
+    snapshot = __atomic_load_n(&thread->snapshot, __ATOMIC_ACQUIRE);
+    
+    if(snapshot == NULL || pthread_mutex_trylock(&thread->snapshot_mutex) != 0) {
+        return;
+    }
+    
+    scene_snapshot_take(snapshot, thread->scene);
+    thread->snapshot_valid = true;
+    
+    pthread_mutex_unlock(&thread->snapshot_mutex);
+}
+
 static void simulate_work(thread_state_t *thread) {
     critter_t   *critter;
     scene_t     *scene;
+    int64_t      start;
+    long         scene_steps;
     float        delta;
     int          step;
     int          idx;
+    int          count;
+    
+    start       = microseconds_now();
+    scene_steps = 0;
     
     scene = thread->scene;
     delta = (float)(BREEDER_TIME_STEP) / (float)MILLISECONDS_PER_SECOND;
     
     thread->critters_out = NULL;
+    thread->steps        = 0;
 
     while(thread->critters_in != NULL) {
         /* add critters to scene */
+        count = 0;
+        
         for(idx = 0; idx < CRITTERS_PER_SCENE; ++idx) {
             /* take a critter from input list */
             critter             = thread->critters_in;
             thread->critters_in = critter->next;
             
             scene_add_critter(scene, critter);
+            ++count;
             
             if(thread->critters_in == NULL) {
                 break;
             }
         }
         
-        /* simulate scene */
-        for(step = 0; step < BREEDER_SIM_STEPS; ++step) {
+        /* Simulate scene. Steps are numbered from the start of the first
+         * run, and the simulation may start in the middle of a run when the
+         * critters have been screened (see screen_critters()). In that case,
+         * the critters continue in a different scene, which follows the last
+         * script from its beginning without resetting the critters. */
+        for(step = thread->first_step; step < thread->last_step && count > 0; ++step) {
+            if(BREEDER_SCRIPTS > 0) {
+                if(step % BREEDER_SIM_STEPS == 0) {
+                    scene_set_script(scene, &thread->scripts[step / BREEDER_SIM_STEPS]);
+                }
+                else if(step == thread->first_step) {
+                    scene_continue_script(scene, &thread->scripts[BREEDER_SCRIPTS]);
+                }
+            }
+            
             scene_update(scene, delta);
+            thread->steps += count;
+            ++scene_steps;
+            
+            if(step % BREEDER_SNAPSHOT_STEPS == 0) {
+                publish_snapshot(thread);
+            }
+            
+            if(BREEDER_EARLY_EXIT) {
+                /* stop simulating the scene once all its critters are gone */
+                count = early_exit(thread, SIMULATION_STEPS - step - 1);
+            }
         }
         
         /* harvest time */
@@ -185,6 +405,10 @@ static void simulate_work(thread_state_t *thread) {
             critter = scene_harvest_critter(scene);
         }
     }
+    
+    /* read by breeder_get_stats() from other threads */
+    __atomic_add_fetch(&thread->scene_steps, scene_steps, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&thread->busy, microseconds_now() - start, __ATOMIC_RELAXED);
 }
 
 static void *simulate_thread(void *param) {
@@ -213,8 +437,127 @@ static void simulate_in_thread(breeder_t *breeder, int thread_index) {
     }
 }
 
+/* Simulate the critters in the input list of each thread from first_step to
+ * last_step and wait for all threads to complete. */
+static void simulate_all(breeder_t *breeder, int first_step, int last_step) {
+    thread_state_t  *thread;
+    int              thread_idx;
+    
+    for(thread_idx = 0; thread_idx < breeder->thread_n; ++thread_idx) {
+        thread = &breeder->threads[thread_idx];
+        
+        /* This will prevent joining threads which we do not actually create. */
+        thread->status      = EAGAIN;
+        thread->first_step  = first_step;
+        thread->last_step   = last_step;
+        
+        /* We simulate the first scene in this thread last, because we want
+         * to start the other threads first. */
+        if(thread_idx > 0) {
+            simulate_in_thread(breeder, thread_idx);
+        }
+    }
+    
+    /* simulate first scene in this thread */
+    simulate_work(&breeder->threads[0]);
+    
+    for(thread_idx = 0; thread_idx < breeder->thread_n; ++thread_idx) {
+        thread = &breeder->threads[thread_idx];
+        
+        /* wait for work to complete */
+        if(thread->status == 0) {
+            (void)pthread_join(thread->thread, NULL);
+        }
+        
+        breeder->steps += thread->steps;
+    }
+}
+
+static int compare_critters(const void *a, const void *b) {
+    float fitness_a;
+    float fitness_b;
+    
+    fitness_a = critter_fitness(*(critter_t * const *)a);
+    fitness_b = critter_fitness(*(critter_t * const *)b);
+    
+    /* best first */
+    if(fitness_a > fitness_b) {
+        return -1;
+    }
+    
+    if(fitness_a < fitness_b) {
+        return 1;
+    }
+    
+    return 0;
+}
+
+/* Rank the critters in the output lists of all threads according to the
+ * fitness score they obtained so far. The BREEDER_SCREEN_DISCARD critters
+ * with the lowest score are done, i.e. they are ranked below the fully
+ * simulated critters (see breeder_next_generation()). The others are
+ * distributed evenly between the threads' input lists for the rest of the
+ * simulation. */
+static void screen_critters(breeder_t *breeder) {
+    critter_t       *critters[BREEDER_POPULATION_SIZE];
+    critter_t       *critter;
+    thread_state_t  *thread;
+    int              thread_idx;
+    int              count;
+    int              keep;
+    int              idx;
+    
+    count = 0;
+    
+    for(thread_idx = 0; thread_idx < breeder->thread_n; ++thread_idx) {
+        thread = &breeder->threads[thread_idx];
+        
+        while(thread->critters_out != NULL) {
+            critter              = thread->critters_out;
+            thread->critters_out = critter->next;
+            
+            critters[count++] = critter;
+        }
+        
+        thread->critters_in = NULL;
+    }
+    
+    qsort(critters, count, sizeof(critter_t *), compare_critters);
+    
+    keep = qrt_max(count - BREEDER_SCREEN_DISCARD, 0);
+    
+    for(idx = 0; idx < count; ++idx) {
+        critter = critters[idx];
+        
+        if(idx < keep) {
+            thread = &breeder->threads[idx % breeder->thread_n];
+            
+            critter->next       = thread->critters_in;
+            thread->critters_in = critter;
+        }
+        else {
+            critter->next                   = breeder->critters_screened_out;
+            breeder->critters_screened_out  = critter;
+        }
+    }
+}
+
+/* The time spent waiting for the lock is accounted for (see
+ * breeder_get_stats()) */
 int breeder_lock(breeder_t *breeder) {
-    return pthread_mutex_lock(&breeder->mutex);
+    int64_t  start;
+    int      status;
+    
+    if(pthread_mutex_trylock(&breeder->mutex) == 0) {
+        return 0;
+    }
+    
+    start   = microseconds_now();
+    status  = pthread_mutex_lock(&breeder->mutex);
+    
+    __atomic_add_fetch(&breeder->lock_wait, microseconds_now() - start, __ATOMIC_RELAXED);
+    
+    return status;
 }
 
 int breeder_unlock(breeder_t *breeder) {
@@ -225,14 +568,36 @@ int breeder_unlock(breeder_t *breeder) {
 bool breeder_next_generation(breeder_t *breeder) {
     qrt_tree_t            population;
     genome_t             *gene_pool[BREEDER_POOL_SIZE];
+    genome_t             *harvest[BREEDER_POPULATION_SIZE];
+    float                 partial[BREEDER_POPULATION_SIZE];
+    genome_t             *babies[BREEDER_POPULATION_SIZE];
+    genome_pair_t         parents[BREEDER_POPULATION_SIZE];
     genome_t            **gene_ptr;
     genome_t             *genome;
+    genome_t             *cached;
     critter_t            *critter;
     thread_state_t       *thread;
     breeder_iterator_t   *iter;
     int                   idx, idy;
     int                   thread_idx;
+    int                   harvest_n;
+    int                   recorded_n;
+    int                   partial_n;
+    int                   babies_n;
+    int                   simulated;
     float                 fitness;
+    float                 threshold;
+    float                 lowest;
+    float                 best_partial;
+    
+    /* The scripts are only read by the worker threads, which are not running
+     * at this point. The extra script is for the rest of a run that was
+     * interrupted by screening (see simulate_work()). */
+    if(BREEDER_SCRIPTS > 0) {
+        for(idx = 0; idx <= BREEDER_SCRIPTS; ++idx) {
+            scene_script_generate(&breeder->scripts[idx]);
+        }
+    }
     
     /* copy population so we don't modify the original */
     (void)qrt_tree_init(&population);
@@ -245,13 +610,28 @@ bool breeder_next_generation(breeder_t *breeder) {
         return false;
     }
     
-    genome = breeder_iterator_current(iter);
+    genome      = breeder_iterator_current(iter);
+    threshold   = 0.0;
+    idx         = 0;
+    
+    fitness_cache_clear(breeder);
     
     while(genome != NULL) {
         fitness = breeder_iterator_fitness(iter);
         qrt_tree_add_value_duplicate(&population, fitness, genome);
 
+        if(BREEDER_FITNESS_CACHE) {
+            fitness_cache_add(breeder, genome);
+        }
+        
+        /* The iterator goes from the best to the worst, so this ends up being
+         * the fitness score of the worst genome that is not discarded. */
+        if(idx < BREEDER_POPULATION_SIZE - BREEDER_WORST_DISCARD) {
+            threshold = fitness;
+        }
+        
         genome   = breeder_iterator_next(iter);
+        ++idx;
     }
     
     breeder_iterator_free(iter);
@@ -288,24 +668,79 @@ bool breeder_next_generation(breeder_t *breeder) {
         
         genome_make_random(genome);
         *(gene_ptr++) = genome;
+        
+        if(breeder->lineage != NULL) {
+            lineage_check(breeder, lineage_write_genome(breeder->lineage, genome));
+        }
     }
     
     qrt_tree_finalize(&population, NULL, NULL);
     
-    /* simulate genomes */
+    /* create babies */
+    babies_n = breeder->thread_n * (BREEDER_POPULATION_SIZE / breeder->thread_n);
+    
+    if(BREEDER_BATCH_BREEDING) {
+        for(idx = 0; idx < babies_n; ++idx) {
+            parents[idx].mommy = gene_pool[rand() % BREEDER_POOL_SIZE];
+            parents[idx].daddy = gene_pool[rand() % BREEDER_POOL_SIZE];
+        }
+        
+        if(!genome_new_array(babies, babies_n)) {
+            return false;
+        }
+        
+        genome_make_babies(babies, parents, babies_n);
+    }
+    else {
+        for(idx = 0; idx < babies_n; ++idx) {
+            babies[idx] = genome_new();
+            
+            if(babies[idx] != NULL) {
+                parents[idx].mommy = gene_pool[rand() % BREEDER_POOL_SIZE];
+                parents[idx].daddy = gene_pool[rand() % BREEDER_POOL_SIZE];
+                
+                genome_make_baby(babies[idx], parents[idx].mommy, parents[idx].daddy);
+            }
+        }
+    }
+    
+    harvest_n   = 0;
+    simulated   = 0;
+    
     for(thread_idx = 0; thread_idx < breeder->thread_n; ++thread_idx) {
         thread = &breeder->threads[thread_idx];
         
-        /* This will prevent joining threads which we do not actually create. */
-        thread->status = EAGAIN;
-        
-        thread->critters_in = NULL;
+        thread->critters_in         = NULL;
+        thread->critters_hopeless   = NULL;
+        thread->threshold           = threshold;
         
         for(idx = 0; idx < BREEDER_POPULATION_SIZE / breeder->thread_n; ++idx) {
-            genome = genome_new();
+            idy     = thread_idx * (BREEDER_POPULATION_SIZE / breeder->thread_n) + idx;
+            genome  = babies[idy];
             
             if(genome != NULL) {
-                genome_make_baby(genome, gene_pool[rand() % BREEDER_POOL_SIZE], gene_pool[rand() % BREEDER_POOL_SIZE]);
+                if(BREEDER_FITNESS_CACHE) {
+                    cached = fitness_cache_lookup(breeder, genome);
+                    
+                    if(cached != NULL) {
+                        /* The baby is identical to a genome we already know
+                         * about, so it inherits that genome's fitness score
+                         * record. */
+                        genome_free(genome);
+                        genome = genome_clone(cached);
+                        
+                        if(genome->fitness_count >= BREEDER_FITNESS_EVALUATIONS) {
+                            harvest[harvest_n++] = genome;
+                            continue;
+                        }
+                    }
+                }
+                
+                /* Babies are recorded now because their parents might no
+                 * longer exist at harvest. */
+                if(breeder->lineage != NULL && genome == babies[idy]) {
+                    lineage_check(breeder, lineage_write_baby(breeder->lineage, genome, parents[idy].mommy, parents[idy].daddy));
+                }
                 
                 critter = critter_new(genome);
                 
@@ -315,51 +750,256 @@ bool breeder_next_generation(breeder_t *breeder) {
                     /* add to list */
                     critter->next       = thread->critters_in;
                     thread->critters_in = critter;
+                    ++simulated;
                 }
             }
         }
-        
-        /* We simulate the first scene in this thread last, because we want
-         * to start the other threads first. */
-        if(thread_idx > 0) {
-            simulate_in_thread(breeder, thread_idx);
-        }
     }
     
-    /* simulate first scene in this thread */
-    simulate_work(&breeder->threads[0]);
+    /* simulate babies */
+    breeder->steps = 0;
+    
+    if(BREEDER_SCREEN_TIME > 0) {
+        simulate_all(breeder, 0, SCREEN_STEPS);
+        screen_critters(breeder);
+        simulate_all(breeder, SCREEN_STEPS, SIMULATION_STEPS);
+    }
+    else {
+        simulate_all(breeder, 0, SIMULATION_STEPS);
+    }
     
     /* critter harvest */
     breeder_lock(breeder);
     
     qrt_tree_clear(breeder->population, tree_finalizer, NULL);
     
+    breeder->steps_saved    = (long)simulated * SIMULATION_STEPS - breeder->steps;
+    breeder->reused         = harvest_n;
+    
     for(thread_idx = 0; thread_idx < breeder->thread_n; ++thread_idx) {
         thread = &breeder->threads[thread_idx];
         
-        /* wait for work to complete */
-        if(thread->status == 0) {
-            (void)pthread_join(thread->thread, NULL);
-        }
-        
         while(thread->critters_out != NULL) {
             critter              = thread->critters_out;
             thread->critters_out = critter->next;
             
             genome  = genome_clone(critter->genome);
-            fitness = BREEDER_FOOD_COST * critter->food_count + BREEDER_DANGER_COST * critter->danger_count;
+            genome_add_fitness(genome, critter_fitness(critter));
             
             critter_free(critter);
             
+            harvest[harvest_n++] = genome;
+        }
+    }
+    
+    /* Critters that were screened out or stopped early only have a partial
+     * score. It is not recorded because their genome may share its fitness
+     * score record with others (see BREEDER_FITNESS_CACHE). These are
+     * harvested last. */
+    partial_n = 0;
+    
+    for(thread_idx = 0; thread_idx < breeder->thread_n; ++thread_idx) {
+        thread = &breeder->threads[thread_idx];
+        
+        while(thread->critters_hopeless != NULL) {
+            critter                     = thread->critters_hopeless;
+            thread->critters_hopeless   = critter->next;
+            
+            partial[partial_n++]    = critter_fitness(critter);
+            harvest[harvest_n++]    = genome_clone(critter->genome);
+            
+            critter_free(critter);
+        }
+    }
+    
+    while(breeder->critters_screened_out != NULL) {
+        critter                         = breeder->critters_screened_out;
+        breeder->critters_screened_out  = critter->next;
+        
+        partial[partial_n++]    = critter_fitness(critter);
+        harvest[harvest_n++]    = genome_clone(critter->genome);
+        
+        critter_free(critter);
+    }
+    
+    recorded_n = harvest_n - partial_n;
+    
+    /* This is done once all fitness scores have been recorded because a genome
+     * can have been simulated more than once in this generation. A partial
+     * score is not on the same scale as a full one, so genomes that only have
+     * a partial score rank below all others, in the order of that score. */
+    lowest          = FLT_MAX;
+    best_partial    = -FLT_MAX;
+    
+    for(idx = 0; idx < harvest_n; ++idx) {
+        genome = harvest[idx];
+        
+        if(genome->fitness_count > 0) {
+            fitness = genome_fitness(genome);
+            
+            if(fitness < lowest) {
+                lowest = fitness;
+            }
+            
             qrt_tree_add_value_duplicate(breeder->population, fitness, genome);
         }
+        else if(partial[idx - recorded_n] > best_partial) {
+            best_partial = partial[idx - recorded_n];
+        }
+    }
+    
+    if(lowest == FLT_MAX) {
+        lowest = best_partial + 1.0;
+    }
+    
+    for(idx = recorded_n; idx < harvest_n; ++idx) {
+        genome = harvest[idx];
+        
+        if(genome->fitness_count == 0) {
+            fitness = lowest - 1.0 - (best_partial - partial[idx - recorded_n]);
+            qrt_tree_add_value_duplicate(breeder->population, fitness, genome);
+        }
+    }
+    
+    if(breeder->lineage != NULL) {
+        lineage_check(breeder, lineage_write_generation(breeder->lineage, harvest, harvest_n));
     }
     
     breeder_unlock(breeder);
     
+    __atomic_add_fetch(&breeder->generations, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&breeder->genomes, simulated, __ATOMIC_RELAXED);
+    
     return true;
 }
 
+/* Record the lineage of all genomes from now on in a file (see lineage.h),
+ * starting with a checkpoint of the current population. */
+bool breeder_start_lineage(breeder_t *breeder, const char *path) {
+    genome_t            *population[BREEDER_POPULATION_SIZE];
+    breeder_iterator_t  *iter;
+    genome_t            *genome;
+    int                  n;
+    bool                 status;
+    
+    breeder_lock(breeder);
+    
+    lineage_writer_free(breeder->lineage);
+    breeder->lineage = lineage_writer_new(path);
+    
+    if(breeder->lineage == NULL) {
+        breeder_unlock(breeder);
+        return false;
+    }
+    
+    iter = breeder_iterator_new(breeder);
+    
+    if(iter == NULL) {
+        lineage_check(breeder, false);
+        breeder_unlock(breeder);
+        return false;
+    }
+    
+    genome  = breeder_iterator_current(iter);
+    n       = 0;
+    
+    while(genome != NULL && n < BREEDER_POPULATION_SIZE) {
+        population[n++] = genome;
+        genome          = breeder_iterator_next(iter);
+    }
+    
+    breeder_iterator_free(iter);
+    
+    /* The first generation is a checkpoint, so all genomes are recorded in
+     * full. */
+    status = lineage_write_generation(breeder->lineage, population, n);
+    
+    lineage_check(breeder, status);
+    breeder_unlock(breeder);
+    
+    return status;
+}
+
+/* Replace the population by the genomes of a library (up to the population
+ * size), completed with novel random genomes if there are not enough of them.
+ * The genomes keep their saved fitness scores for the first selection. Returns
+ * the number of genomes taken from the library. */
+int breeder_seed(breeder_t *breeder, const library_t *library) {
+    genome_t    *genome;
+    int          count;
+    int          idx;
+    
+    count = library_count(library);
+    
+    if(count > BREEDER_POPULATION_SIZE) {
+        count = BREEDER_POPULATION_SIZE;
+    }
+    
+    breeder_lock(breeder);
+    
+    qrt_tree_clear(breeder->population, tree_finalizer, NULL);
+    
+    for(idx = 0; idx < BREEDER_POPULATION_SIZE; ++idx) {
+        if(idx < count) {
+            genome = library_genome(library, idx);
+        }
+        else {
+            genome = genome_new();
+            
+            if(genome != NULL) {
+                genome_make_random(genome);
+            }
+        }
+        
+        if(genome == NULL) {
+            if(idx < count) {
+                count = idx;
+            }
+            continue;
+        }
+        
+        (void)qrt_tree_add_value_duplicate(breeder->population, idx < count ? library_fitness(library, idx) : 0.0, genome);
+    }
+    
+    breeder_unlock(breeder);
+    
+    return count;
+}
+
+/* Save the population, best first, to a library file */
+bool breeder_save_library(breeder_t *breeder, const char *path) {
+    genome_t            *population[BREEDER_POPULATION_SIZE];
+    breeder_iterator_t  *iter;
+    genome_t            *genome;
+    int                  n;
+    bool                 status;
+    
+    breeder_lock(breeder);
+    
+    iter = breeder_iterator_new(breeder);
+    
+    if(iter == NULL) {
+        breeder_unlock(breeder);
+        return false;
+    }
+    
+    genome  = breeder_iterator_current(iter);
+    n       = 0;
+    
+    while(genome != NULL && n < BREEDER_POPULATION_SIZE) {
+        population[n++] = genome;
+        genome          = breeder_iterator_next(iter);
+    }
+    
+    breeder_iterator_free(iter);
+    
+    status = library_write(path, population, n);
+    
+    breeder_unlock(breeder);
+    
+    return status;
+}
+
 float breeder_fitness_n(breeder_t *breeder, int n) {
     breeder_iterator_t   *iter;
     int                   count;
@@ -391,6 +1031,52 @@ float breeder_fitness(breeder_t *breeder) {
     return breeder_fitness_n(breeder, BREEDER_BEST_KEEP);
 }
 
+/* Publish the champions of the last generation, replacing those of the
+ * previous one if they were not taken. The population is read under the lock
+ * because other threads can replace it (e.g. breeder_seed()). */
+static void publish_champions(breeder_t *breeder) {
+    breeder_champions_t *champions;
+    breeder_iterator_t  *iter;
+    genome_t            *genome;
+    float                fitness;
+    
+    champions = qrt_new(breeder_champions_t);
+    
+    if(champions == NULL) {
+        return;
+    }
+    
+    breeder_lock(breeder);
+    
+    iter = breeder_iterator_new(breeder);
+    
+    if(iter == NULL) {
+        breeder_unlock(breeder);
+        free(champions);
+        return;
+    }
+    
+    genome  = breeder_iterator_current(iter);
+    fitness = 0.0;
+    
+    champions->count        = 0;
+    champions->generation   = breeder->generation;
+    
+    while(genome != NULL && champions->count < BREEDER_CHAMPIONS) {
+        champions->genome[champions->count++] = genome_clone(genome);
+        fitness += breeder_iterator_fitness(iter);
+        
+        genome = breeder_iterator_next(iter);
+    }
+    
+    breeder_iterator_free(iter);
+    breeder_unlock(breeder);
+    
+    champions->fitness = (champions->count > 0) ? fitness / (float)champions->count : 0.0;
+    
+    breeder_champions_free(__atomic_exchange_n(&breeder->champions, champions, __ATOMIC_ACQ_REL));
+}
+
 static void *loop_thread(void *param) {
     struct timeval       generation_start;
     struct timeval       ticks;
@@ -403,14 +1089,19 @@ static void *loop_thread(void *param) {
         breeder_next_generation(breeder);
         gettimeofday(&ticks, NULL);
         
+        publish_champions(breeder);
+        
         if(breeder->generation % 50 == 0) {
             breeder_lock(breeder);
             
             printf(
-                    "generation: %6u duration (ms): %4u fitness: " FITNESS_FORMAT "\n",
+                    "generation: %6u duration (ms): %4u fitness: " FITNESS_FORMAT " steps saved: %7ld (%4.1f%%) reused: %3d\n",
                     breeder->generation,
                     interval_milliseconds(&generation_start, &ticks),
-                    breeder_fitness(breeder));
+                    breeder_fitness(breeder),
+                    breeder->steps_saved,
+                    100.0 * (float)breeder->steps_saved / (float)(breeder->steps + breeder->steps_saved),
+                    breeder->reused);
                     
             breeder_unlock(breeder);
         }
@@ -506,3 +1197,98 @@ genome_t *breeder_iterator_next(breeder_iterator_t *iter) {
 float breeder_iterator_fitness(breeder_iterator_t *iter) {
     return qrt_tree_iterator_key(iter->qrt_tree_iter);
 }
+
+/* Take the champions published after the last generation, without locking
+ * the breeder. Returns NULL if they have already been taken, until the next
+ * generation. The caller owns the result and must free it with
+ * breeder_champions_free(). */
+breeder_champions_t *breeder_take_champions(breeder_t *breeder) {
+    return __atomic_exchange_n(&breeder->champions, NULL, __ATOMIC_ACQ_REL);
+}
+
+void breeder_champions_free(breeder_champions_t *champions) {
+    int idx;
+    
+    if(champions != NULL) {
+        for(idx = 0; idx < champions->count; ++idx) {
+            genome_free(champions->genome[idx]);
+        }
+    }
+    
+    free(champions);
+}
+
+/* Read the counters of the work done by the breeder so far. This does not
+ * lock the breeder, so it can be called at any time from any thread. */
+void breeder_get_stats(breeder_t *breeder, breeder_stats_t *stats) {
+    thread_state_t  *thread;
+    int              idx;
+    
+    stats->generations  = __atomic_load_n(&breeder->generations, __ATOMIC_RELAXED);
+    stats->genomes      = __atomic_load_n(&breeder->genomes,     __ATOMIC_RELAXED);
+    stats->lock_wait    = __atomic_load_n(&breeder->lock_wait,   __ATOMIC_RELAXED);
+    stats->scene_steps  = 0;
+    stats->thread_n     = 0;
+    
+    for(idx = 0; idx < breeder->thread_n; ++idx) {
+        thread = &breeder->threads[idx];
+        
+        stats->scene_steps += __atomic_load_n(&thread->scene_steps, __ATOMIC_RELAXED);
+        
+        if(idx < BREEDER_STATS_THREADS) {
+            stats->busy[idx] = __atomic_load_n(&thread->busy, __ATOMIC_RELAXED);
+            ++stats->thread_n;
+        }
+    }
+}
+
+/* Have the thread of each scene where critters are simulated publish
+ * snapshots of its scene every BREEDER_SNAPSHOT_STEPS time steps, e.g. to
+ * watch the simulation. */
+bool breeder_enable_snapshots(breeder_t *breeder) {
+    scene_snapshot_t    *snapshot;
+    int                  idx;
+    
+    for(idx = 0; idx < breeder->thread_n; ++idx) {
+        if(breeder->threads[idx].snapshot != NULL) {
+            continue;
+        }
+        
+        snapshot = scene_snapshot_new();
+        
+        if(snapshot == NULL) {
+            return false;
+        }
+        
+        /* the thread may be running */
+        __atomic_store_n(&breeder->threads[idx].snapshot, snapshot, __ATOMIC_RELEASE);
+    }
+    
+    return true;
+}
+
+/* Number of scenes where critters are simulated at the same time, one per
+ * thread */
+int breeder_scene_count(breeder_t *breeder) {
+    return breeder->thread_n;
+}
+
+/* Copy the last snapshot of a scene. Returns false if there is none yet. */
+bool breeder_scene_snapshot(breeder_t *breeder, int index, scene_snapshot_t *snapshot) {
+    thread_state_t  *thread;
+    bool             valid;
+    
+    thread = &breeder->threads[index];
+    
+    pthread_mutex_lock(&thread->snapshot_mutex);
+    
+    valid = thread->snapshot_valid;
+    
+    if(valid) {
+        scene_snapshot_copy(snapshot, thread->snapshot);
+    }
+    
+    pthread_mutex_unlock(&thread->snapshot_mutex);
+    
+    return valid;
+}
@@ -30,7 +30,10 @@
 #define _CRITTERS_BREEDER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "genome.h"
+#include "library.h"
+#include "scene.h"
 
 /* Selection procedure: First, the genomes with the lowest fitness score are
  * discarded. Then, a pool of genomes is created by picking the genomes with
@@ -72,11 +75,105 @@
 /* Fitness score: number of points gained (negative for loss) each time the critter is captured */
 #define BREEDER_DANGER_COST         -50.0
 
+/* Early exit: set to one to stop simulating a critter as soon as its fitness
+ * score is unlikely to reach the survival threshold, i.e. the fitness score
+ * of the worst genome of the previous generation that was not discarded (see
+ * BREEDER_EARLY_EXIT_RATE). Unless its genome already has a fitness score, it
+ * ranks below all fully simulated genomes in this generation, and its partial
+ * score is not recorded. Removing a critter from
+ * its scene also changes the competition for food of the critters left in
+ * it. Set to zero to always simulate critters for the full BREEDER_SIM_TIME. */
+#define BREEDER_EARLY_EXIT            0
+
+/* Early exit: number of points a critter is assumed to gain at most for each
+ * second of simulation that remains. This is a heuristic, not a bound: a
+ * critter near several food items can gain points faster, so good critters
+ * can occasionally be stopped. A critter is considered hopeless once its
+ * fitness score plus this rate times the remaining time is under the
+ * survival threshold. */
+#define BREEDER_EARLY_EXIT_RATE     1.0
+
+/* Fitness cache: set to one to recognize babies that are identical to a genome
+ * of the previous generation (e.g. no crossover difference and no mutation).
+ * Such a baby shares the fitness score record of that genome instead of
+ * starting from scratch. Set to zero to evaluate every baby independently. */
+#define BREEDER_FITNESS_CACHE         1
+
+/* Fitness cache: the fitness score of a genome is the average of the scores
+ * of up to this many simulations. Once a genome has been simulated that many
+ * times, its average score is reused as is and it is not simulated again. */
+#define BREEDER_FITNESS_EVALUATIONS   3
+
+/* Common random numbers: number of scene scripts generated at each generation.
+ * Every genome of the generation is simulated once following each of these
+ * scripts, so all genomes face the same initial positions and the same
+ * sequence of food positions, and its fitness score is the average over all
+ * scripts. Set to zero to use fresh random numbers for each scene instead. */
+#define BREEDER_SCRIPTS               0
+
+/* Reduced precision: precision of the simulation (see scene_set_precision()),
+ * i.e. 0 for floating point (SCENE_PRECISION_FLOAT), 1 for 16-bit fixed-point
+ * values for the brain and positions (SCENE_PRECISION_FIXED) or 2 for 8-bit
+ * brain weights (SCENE_PRECISION_INT8). */
+#define BREEDER_PRECISION             0
+
+/* Screening: when non-zero, all babies are first simulated for this time
+ * only (in seconds). Then, the BREEDER_SCREEN_DISCARD babies with the lowest
+ * fitness score at that point are considered unlikely to survive the next
+ * discard. Unless their genome already has a fitness score, they rank below
+ * all fully simulated genomes in this generation, and their partial score is
+ * not recorded. Only the others are simulated for the rest of
+ * BREEDER_SIM_TIME. Set to zero to simulate all babies for the full time. */
+#define BREEDER_SCREEN_TIME           0
+
+/* Screening: number of babies that are not simulated past the screening time.
+ * Should not be more than BREEDER_WORST_DISCARD. */
+#define BREEDER_SCREEN_DISCARD       40
+
+/* Batched breeding: set to one to create all babies of a generation at once
+ * with genome_make_babies(), which uses a faster random number generator than
+ * rand() and no branches for crossover. Set to zero to create them one by one
+ * with genome_make_baby(). */
+#define BREEDER_BATCH_BREEDING        1
+
+/* Number of best genomes published after each generation by the thread
+ * started with breeder_start_loop() (see breeder_take_champions()) */
+#define BREEDER_CHAMPIONS             5
+
+/* Maximum number of threads reported individually by breeder_get_stats() */
+#define BREEDER_STATS_THREADS         16
+
+/* When scene snapshots are enabled (see breeder_enable_snapshots()), number
+ * of time steps between two snapshots of the scene of each thread */
+#define BREEDER_SNAPSHOT_STEPS        2
+
 
 typedef struct breeder_t breeder_t;
 
 typedef struct breeder_iterator_t breeder_iterator_t;
 
+typedef struct breeder_champions_t breeder_champions_t;
+
+/* The best genomes of a generation, best first, with a reference to each */
+struct breeder_champions_t {
+    genome_t    *genome[BREEDER_CHAMPIONS];
+    int          count;
+    int          generation;
+    float        fitness;   /* mean fitness score of these genomes */
+};
+
+
+/* Counters of the work done by the breeder since it was created. Rates are
+ * computed from the difference between two of these. */
+typedef struct {
+    long         generations;
+    long         genomes;       /* number of genomes simulated */
+    long         scene_steps;   /* time steps of the scenes of all threads */
+    int64_t      lock_wait;     /* time spent waiting for the lock (us) */
+    int          thread_n;
+    int64_t      busy[BREEDER_STATS_THREADS];   /* time simulating (us) */
+} breeder_stats_t;
+
 
 breeder_t *breeder_new(int thread_n);
 
@@ -96,6 +193,24 @@ int breeder_start_loop(breeder_t *breeder);
 
 void breeder_dump_population(breeder_t *breeder);
 
+bool breeder_start_lineage(breeder_t *breeder, const char *path);
+
+int breeder_seed(breeder_t *breeder, const library_t *library);
+
+bool breeder_save_library(breeder_t *breeder, const char *path);
+
+breeder_champions_t *breeder_take_champions(breeder_t *breeder);
+
+void breeder_champions_free(breeder_champions_t *champions);
+
+void breeder_get_stats(breeder_t *breeder, breeder_stats_t *stats);
+
+bool breeder_enable_snapshots(breeder_t *breeder);
+
+int breeder_scene_count(breeder_t *breeder);
+
+bool breeder_scene_snapshot(breeder_t *breeder, int index, scene_snapshot_t *snapshot);
+
 
 breeder_iterator_t *breeder_iterator_new(breeder_t *breeder);
 
@@ -29,10 +29,13 @@
 #define _BSD_SOURCE /* for M_* constants in math.h */
 #define _GNU_SOURCE /* for sincosf() in math.h */
 #include <quatre/macros.h>
+#include <malloc.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include "critter.h"
+#include "sprite.h"
 #include "util.h"
 
 /* in pixels per second */
@@ -43,33 +46,43 @@
 
 #define BOUND 10
 
+/* the sprite of the thing must fit in a sprite_t (see sprite_rasterize()) */
+#if BOUND > SPRITE_MAX_BOUND
+#error "BOUND must not be larger than SPRITE_MAX_BOUND"
+#endif
+
+/* Number of entries of the sprite cache shared by all critters */
+#define SPRITE_CACHE_SIZE 256
+
+static sprite_cache_t *sprite_cache = NULL;
+
 
 static bool render_func(void *this_ptr, int x, int y) {
-    critter_t *critter;
-    float      bound;
-    float      distance;
-    float      dx, dy;
+    critter_appearance_t    *appearance;
+    float                    bound;
+    float                    distance;
+    float                    dx, dy;
     
-    critter = (critter_t *)this_ptr;
-    bound   = (float)critter->thing.bound;
+    appearance  = (critter_appearance_t *)this_ptr;
+    bound       = (float)appearance->thing.bound;
     
-    dx = critter->cx2 - (float)x;
-    dy = critter->cy2 - (float)y;
+    dx = appearance->cx2 - (float)x;
+    dy = appearance->cy2 - (float)y;
     
     distance = sqrtf( (dx*dx + dy*dy) );
     
     if(distance < 0.7 * bound) {
-        critter->thing.colour = rgb(100, 100, 200);
+        appearance->thing.colour = rgb(100, 100, 200);
         return true;
     }
     
-    dx = critter->cx1 - (float)x;
-    dy = critter->cy1 - (float)y;
+    dx = appearance->cx1 - (float)x;
+    dy = appearance->cy1 - (float)y;
     
     distance = sqrtf( (dx*dx + dy*dy) );
     
     if(distance < 0.4 * bound) {
-        critter->thing.colour = critter->genome->colour;
+        appearance->thing.colour = appearance->head_colour;
         return true;
     }
     
@@ -77,18 +90,57 @@ static bool render_func(void *this_ptr, int x, int y) {
 }
 
 static void pre_render_func(void *this_ptr) {
-    critter_t *critter;
-    float cx, cy;
+    critter_appearance_t    *appearance;
+    float                    cx, cy;
     
-    critter = (critter_t *)this_ptr;
+    appearance = (critter_appearance_t *)this_ptr;
     
-    cx =  (int)((float)critter->thing.bound * cosf(critter->angle));
-    cy = -(int)((float)critter->thing.bound * sinf(critter->angle));
+    cx =  (int)((float)appearance->thing.bound * cosf(appearance->angle));
+    cy = -(int)((float)appearance->thing.bound * sinf(appearance->angle));
     
-    critter->cx1 = 0.6 * cx;
-    critter->cy1 = 0.6 * cy;
-    critter->cx2 = 0.3 * (-cx);
-    critter->cy2 = 0.3 * (-cy);
+    appearance->cx1 = 0.6 * cx;
+    appearance->cy1 = 0.6 * cy;
+    appearance->cx2 = 0.3 * (-cx);
+    appearance->cy2 = 0.3 * (-cy);
+}
+
+/* The shape of a critter only depends on its angle, rounded to a whole
+ * number of pixels by pre_render_func(), and on the colour of its head, so
+ * critters with the same rounded angle and colour share a sprite. */
+static const sprite_t *sprite_func(void *this_ptr) {
+    static sprite_t          sprite;
+    critter_appearance_t    *appearance;
+    sprite_t                *cached;
+    uint64_t                 key;
+    bool                     hit;
+    int                      cx, cy;
+    
+    appearance = (critter_appearance_t *)this_ptr;
+    
+    if(sprite_cache == NULL) {
+        sprite_cache = sprite_cache_new(SPRITE_CACHE_SIZE);
+    }
+    
+    cx =  (int)((float)appearance->thing.bound * cosf(appearance->angle));
+    cy = -(int)((float)appearance->thing.bound * sinf(appearance->angle));
+    
+    key = ((uint64_t)appearance->head_colour << 32) | ((uint32_t)(cx + BOUND) << 16) | (uint32_t)(cy + BOUND);
+    
+    /* without a cache, rasterize every time */
+    if(sprite_cache == NULL) {
+        cached  = &sprite;
+        hit     = false;
+    }
+    else {
+        cached = sprite_cache_get(sprite_cache, key, &hit);
+    }
+    
+    if(! hit) {
+        pre_render_func(appearance);
+        sprite_rasterize(cached, &appearance->thing);
+    }
+    
+    return cached;
 }
 
 static void update_func(void *this_ptr, float delta, float w, float h) {
@@ -111,7 +163,7 @@ static void update_func(void *this_ptr, float delta, float w, float h) {
     speed    = BASE_SPEED_FORWARD * (right_speed + left_speed) * 0.5;
     delta_s  = (float)delta * speed;
     
-    sincosf(critter->angle, &uy, &ux);
+    sincosf(critter->appearance.angle, &uy, &ux);
     
     x = critter_get_x(critter) + ux * delta_s;
     y = critter_get_y(critter) - uy * delta_s;
@@ -136,14 +188,14 @@ static void update_func(void *this_ptr, float delta, float w, float h) {
     omega        = BASE_SPEED_ANGULAR * (right_speed - left_speed);
     delta_angle  = (float)delta * omega;
     
-    critter->angle += delta_angle;
+    critter->appearance.angle += delta_angle;
         
-    while(critter->angle < -M_PI) {
-        critter->angle += 2 * M_PI;
+    while(critter->appearance.angle < -M_PI) {
+        critter->appearance.angle += 2 * M_PI;
     }
     
-    while(critter->angle > M_PI) {
-        critter->angle -= 2 * M_PI;
+    while(critter->appearance.angle > M_PI) {
+        critter->appearance.angle -= 2 * M_PI;
     }
 }
 
@@ -163,26 +215,34 @@ critter_t *critter_new(genome_t *genome) {
     critter_t *critter;
     bool       ret;
     
-    critter = qrt_new(critter_t);
+    /* aligned for the brain state */
+    critter = memalign(__alignof__(critter_t), offsetof(critter_t, brain_compiled) + brain_compiled_size());
     
     if(critter != NULL) {
         critter->genome = genome_clone(genome);
-        critter->angle          = 0.0;
+        critter->appearance.head_colour = genome->colour;
+        critter->appearance.angle       = 0.0;
+        
+        brain_compile(&critter->brain_compiled, genome);
+        critter->brain_fixed_ready  = false;
+        critter->brain_int8_ready   = false;
+        brain_state_init(&critter->brain_state);
         critter->food_count     = 0;
         critter->danger_count   = 0;
         
         ret  = brain_control_init(&critter->brain_control);
         ret &= thing_init(
-                &critter->thing,    /* object to initialize */
-                THING_KIND_CRITTER, /* kind */
-                0.0, 0.0,           /* position */
-                BOUND,              /* bounding box size */
-                rgb(100, 100, 200), /* colour */
-                critter,            /* this (self) pointer */
-                render_func,        /* rendering function */
-                pre_render_func,    /* pre-rendering function */
-                update_func,        /* position update function */
-                free_func );        /* finalizer */
+                &critter->appearance.thing, /* object to initialize */
+                THING_KIND_CRITTER,         /* kind */
+                0.0, 0.0,                   /* position */
+                BOUND,                      /* bounding box size */
+                rgb(100, 100, 200),         /* colour */
+                critter,                    /* this (self) pointer */
+                render_func,                /* rendering function */
+                pre_render_func,            /* pre-rendering function */
+                sprite_func,                /* sprite function */
+                update_func,                /* position update function */
+                free_func );                /* finalizer */
             
         if(! ret) {
             free(critter);
@@ -38,58 +38,122 @@
 
 typedef struct critter_t critter_t;
 
-struct critter_t {
+/* What is needed to render a critter, e.g. in a scene snapshot. Only the
+ * rendering functions of its thing may be called. */
+typedef struct {
     thing_t          thing;
+    uint32_t         head_colour;
+    float            angle;
+    float            cx1;
+    float            cy1;
+    float            cx2;
+    float            cy2;
+} critter_appearance_t;
+
+/* The appearance comes first so the rendering functions of the thing can
+ * take either one. */
+struct critter_t {
+    critter_appearance_t appearance;
     genome_t        *genome;
+    brain_fixed_t    brain_fixed;
+    brain_int8_t     brain_int8;
+    brain_state_t    brain_state;
     brain_control_t  brain_control;
     critter_t       *next;
-    float            angle;
     int              food_count;
     int              danger_count;
-            
-    float           cx1;
-    float           cy1;
-    float           cx2;
-    float           cy2;
+    /* The reduced precision weights are only quantized for the precision
+     * that is used, on its first use */
+    bool             brain_fixed_ready;
+    bool             brain_int8_ready;
+    /* Last, so only the chunks used by the selected topology are allocated
+     * (see critter_new()) */
+    brain_compiled_t brain_compiled;
 };
 
 critter_t *critter_new(genome_t *genome);
 
 static inline void critter_free(critter_t *critter) {
-    thing_free(&critter->thing);
+    thing_free(&critter->appearance.thing);
 }
 
 static inline void critter_render(critter_t *critter, SDL_Surface *screen, int v_offset, int h_offset) {
-    thing_render(&critter->thing, screen, v_offset, h_offset);
+    thing_render(&critter->appearance.thing, screen, v_offset, h_offset);
 }
 
 static inline void critter_update_position(critter_t *critter, float delta, float w, float h) {
-    thing_update_position(&critter->thing, delta, w, h);
+    thing_update_position(&critter->appearance.thing, delta, w, h);
 }
 
 static inline void critter_update_brain(critter_t *critter, const stimuli_t *stimuli) {
-    brain_control_compute(&critter->brain_control, critter->genome, stimuli);    
+    brain_control_compute(&critter->brain_control, &critter->brain_compiled, stimuli, &critter->brain_state);    
+}
+
+/* Prepare the brain computation of this critter for a batch (see
+ * brain_control_compute_batch()) */
+static inline void critter_brain_job(critter_t *critter, brain_job_t *job, const stimuli_t *stimuli) {
+    job->control    = &critter->brain_control;
+    job->compiled   = &critter->brain_compiled;
+    job->stimuli    = stimuli;
+    job->state      = &critter->brain_state;
+}
+
+static inline void critter_update_brain_fixed(critter_t *critter, const stimuli_t *stimuli) {
+    if(!critter->brain_fixed_ready) {
+        brain_fixed_quantize(&critter->brain_fixed, critter->genome);
+        critter->brain_fixed_ready = true;
+    }
+    
+    brain_control_compute_fixed(&critter->brain_control, &critter->brain_fixed, stimuli);
+}
+
+static inline void critter_update_brain_int8(critter_t *critter, const stimuli_t *stimuli) {
+    if(!critter->brain_int8_ready) {
+        brain_int8_quantize(&critter->brain_int8, critter->genome);
+        critter->brain_int8_ready = true;
+    }
+    
+    brain_control_compute_int8(&critter->brain_control, &critter->brain_int8, stimuli);
 }
 
 static inline void critter_genome_transplant(critter_t *critter, genome_t *genome) {
      genome_free(critter->genome);
      critter->genome = genome_clone(genome);
+     critter->appearance.head_colour = genome->colour;
+     brain_compile(&critter->brain_compiled, genome);
+     critter->brain_fixed_ready = false;
+     critter->brain_int8_ready = false;
+     brain_state_init(&critter->brain_state);
+}
+
+/* Copy only what is needed to render the critter */
+static inline void critter_copy_appearance(critter_appearance_t *copy, const critter_appearance_t *appearance) {
+    *copy                   = *appearance;
+    copy->thing.this_ptr    = copy;
+}
+
+static inline const critter_appearance_t *critter_get_appearance(const critter_t *critter) {
+    return &critter->appearance;
+}
+
+static inline void critter_appearance_render(critter_appearance_t *appearance, SDL_Surface *screen, int v_offset, int h_offset) {
+    thing_render(&appearance->thing, screen, v_offset, h_offset);
 }
 
 static inline void critter_set_position(critter_t *critter, float x, float y) {
-    thing_set_position(&critter->thing, x, y);
+    thing_set_position(&critter->appearance.thing, x, y);
 }
 
 static inline float critter_get_x(critter_t *critter) {
-    return thing_get_x(&critter->thing);
+    return thing_get_x(&critter->appearance.thing);
 }
 
 static inline float critter_get_y(critter_t *critter) {
-    return thing_get_y(&critter->thing);
+    return thing_get_y(&critter->appearance.thing);
 }
 
 static inline thing_t *critter_get_thing(critter_t *critter) {
-    return &critter->thing;
+    return &critter->appearance.thing;
 }
 
 #endif
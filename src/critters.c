@@ -31,12 +31,19 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include "brain.h"
 #include "breeder.h"
 #include "critter.h"
+#include "frame.h"
 #include "genome.h"
+#include "hud.h"
+#include "library.h"
+#include "renderer.h"
 #include "scene.h"
+#include "tiles.h"
 #include "window.h"
 #include "util.h"
 
@@ -46,6 +53,26 @@
 #define NUMBER_OF_CORES   0
 #endif
 
+/* Library file to which the population is saved (key S) unless one is given
+ * with -g */
+#define LIBRARY_FILE    "critters.lib"
+
+/* Rate at which the window is rendered, in frames per second */
+#define FRAME_RATE      60
+
+/* Rate at which the scene of the window is updated when it is rendered by a
+ * separate thread, in updates per second */
+#define UPDATE_RATE     120
+
+/* If non-zero, the window is rendered by a separate thread, from snapshots of
+ * the scene, at FRAME_RATE while the main thread updates the scene at
+ * UPDATE_RATE (see renderer.h). Otherwise, the main thread updates and renders
+ * at FRAME_RATE. Some platforms (e.g. MacOS X) only allow rendering from the
+ * main thread. */
+#define RENDER_THREAD   0
+
+#define USAGE           "Usage: %s [-g library] [topology [operators [lineage]]]\n"
+
 static void graphics_initialize(void) {
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         fprintf(stderr, "Unable to init SDL: %s\n", SDL_GetError());
@@ -55,20 +82,81 @@ static void graphics_initialize(void) {
     atexit(SDL_Quit);
 }
 
-int main(void) {
+int main(int argc, char *argv[]) {
     SDL_Event            event;
+    genome_topology_t    topology;
     breeder_t           *breeder;
     critter_t           *scene_critter;
-    breeder_iterator_t  *iter;
+    breeder_champions_t *champions;
     genome_t            *genome;
+    library_t           *library;
+    const char          *library_path;
     scene_t             *scene;
     window_t            *window;
+    renderer_t          *renderer;
+    tiles_t             *tiles;
+    hud_t               *hud;
+    frame_clock_t        clock;
     struct timeval       ticks;
     struct timeval       round_start;
     int                  round_duration_seconds;
     int                  idx;
-    int                  count;
+    int                  crossover;
+    int                  mutation;
     bool                 updated_once;
+    bool                 tiled;
+    bool                 hud_shown;
+    
+    library         = NULL;
+    library_path    = LIBRARY_FILE;
+    
+    if(argc > 2 && strcmp(argv[1], "-g") == 0) {
+        /* genome library from which the breeder is seeded and the first
+         * critters of the scene are taken (see library.h) */
+        library_path    = argv[2];
+        library         = library_open(library_path);
+        
+        if(library == NULL) {
+            fprintf(stderr, "Cannot open library: %s\n", library_path);
+            return EXIT_FAILURE;
+        }
+        
+        argv[2] = argv[0];
+        argv   += 2;
+        argc   -= 2;
+    }
+    
+    if(argc > 1) {
+        /* topology of the brain, e.g. "8r" (default) or "4s4r/4r" (see
+         * genome_topology_parse()) */
+        if(!genome_topology_parse(&topology, argv[1])) {
+            fprintf(stderr, "Invalid topology: %s\n", argv[1]);
+            fprintf(stderr, USAGE, argv[0]);
+            return EXIT_FAILURE;
+        }
+        
+        brain_set_topology(&topology);
+    }
+    else if(library != NULL) {
+        brain_set_topology(library_topology(library));
+    }
+    
+    if(library != NULL && !genome_topology_equal(genome_get_topology(), library_topology(library))) {
+        fprintf(stderr, "Topology does not match that of the library\n");
+        return EXIT_FAILURE;
+    }
+    
+    if(argc > 2) {
+        /* crossover and mutation operators, e.g. "gene/replace" (default) or
+         * "blend/gaussian" (see genome_operators_parse()) */
+        if(!genome_operators_parse(argv[2], &crossover, &mutation)) {
+            fprintf(stderr, "Invalid operators: %s\n", argv[2]);
+            fprintf(stderr, USAGE, argv[0]);
+            return EXIT_FAILURE;
+        }
+        
+        genome_set_operators(crossover, mutation);
+    }
     
     srand( time(NULL) );
     
@@ -82,8 +170,17 @@ int main(void) {
     }
     
     for(idx = 0; idx < 5; ++idx) {
-        genome = genome_new();
-        genome_make_random(genome);
+        if(library != NULL && idx < library_count(library)) {
+            /* champions of the library */
+            genome = library_genome(library, idx);
+        }
+        else {
+            genome = genome_new();
+            
+            if(genome != NULL) {
+                genome_make_random(genome);
+            }
+        }
         
         if(genome != NULL) {
             scene_critter = critter_new(genome);
@@ -113,6 +210,45 @@ int main(void) {
         return EXIT_FAILURE;
     }
     
+    if(library != NULL) {
+        breeder_seed(breeder, library);
+        library_close(library);
+    }
+    
+    if(argc > 3) {
+        /* record the lineage of all genomes in this file (see lineage.h) */
+        if(!breeder_start_lineage(breeder, argv[3])) {
+            fprintf(stderr, "Cannot create lineage file: %s\n", argv[3]);
+            breeder_free(breeder);
+            window_free(window);
+            scene_free(scene);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    renderer    = NULL;
+    tiles       = NULL;
+    tiled       = false;
+    hud         = NULL;
+    hud_shown   = false;
+    
+    if(RENDER_THREAD) {
+        renderer = renderer_new(window, FRAME_RATE);
+        
+        if(renderer == NULL) {
+            fprintf(stderr, "Cannot create render thread\n");
+            breeder_free(breeder);
+            window_free(window);
+            scene_free(scene);
+            return EXIT_FAILURE;
+        }
+        
+        frame_clock_init(&clock, UPDATE_RATE);
+    }
+    else {
+        frame_clock_init(&clock, FRAME_RATE);
+    }
+    
     breeder_start_loop(breeder);
     
     gettimeofday(&round_start, NULL);
@@ -124,6 +260,30 @@ int main(void) {
             switch (event.type) {
             case SDL_QUIT:
                 exit(EXIT_SUCCESS);
+            case SDL_VIDEORESIZE:
+                if(renderer == NULL) {
+                    window_resize(window, event.resize.w, event.resize.h);
+                    break;
+                }
+                
+                /* the render thread draws on the screen, which is replaced */
+                renderer_free(renderer);
+                window_resize(window, event.resize.w, event.resize.h);
+                renderer = renderer_new(window, FRAME_RATE);
+                
+                if(renderer == NULL) {
+                    fprintf(stderr, "Cannot create render thread\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case SDL_VIDEOEXPOSE:
+                if(renderer == NULL) {
+                    window_invalidate(window);
+                }
+                else {
+                    renderer_invalidate(renderer);
+                }
+                break;
             case SDL_KEYUP:
                 switch(event.key.keysym.sym) {
                 
@@ -144,10 +304,43 @@ int main(void) {
                     breeder_dump_population(breeder);
                     break;
                     
+                case SDLK_f:
+                    window_set_fast_forward(window, !window_get_fast_forward(window));
+                    break;
+                    
+                case SDLK_t:
+                    /* tiled view of the scenes of the breeder, only when
+                     * rendering from this thread */
+                    if(renderer == NULL && tiles == NULL) {
+                        tiles = tiles_new(breeder);
+                    }
+                    
+                    tiled = (tiles != NULL && !tiled);
+                    break;
+                    
+                case SDLK_h:
+                    /* performance HUD, only when rendering from this thread */
+                    if(renderer == NULL && hud == NULL) {
+                        hud = hud_new(breeder);
+                    }
+                    
+                    hud_shown = (hud != NULL && !hud_shown);
+                    window_set_hud(window, hud_shown ? hud : NULL);
+                    break;
+                    
                 case SDLK_r:
                     scene_shake(scene);
                     break;
                     
+                case SDLK_s:
+                    if(breeder_save_library(breeder, library_path)) {
+                        printf("population saved to %s\n", library_path);
+                    }
+                    else {
+                        fprintf(stderr, "Cannot save library: %s\n", library_path);
+                    }
+                    break;
+                    
                 default:
                     break;
                 }
@@ -156,44 +349,52 @@ int main(void) {
         
         /* update and render window content */
         window_update(window);
-        window_render(window);
+        
+        if(renderer != NULL) {
+            renderer_submit(renderer);
+        }
+        else if(tiled) {
+            window_render_tiles(window, tiles);
+        }
+        else {
+            window_render(window);
+        }
         
         /* update view after 2 seconds and then every 20 seconds */
         gettimeofday(&ticks, NULL);
         round_duration_seconds = interval_milliseconds(&round_start, &ticks) / 1000;
         
         if(round_duration_seconds >= 20 || (! updated_once && round_duration_seconds >= 2)) {
-            breeder_lock(breeder);
-            
-            gettimeofday(&round_start, NULL);
-            updated_once    = true;
+            /* the champions of the latest generation, if they have not
+             * already been taken (otherwise, try again at the next frame) */
+            champions = breeder_take_champions(breeder);
             
-            scene_critter = scene_first_critter(scene);
-            iter = breeder_iterator_new(breeder);
+            if(champions != NULL) {
+                gettimeofday(&round_start, NULL);
+                updated_once    = true;
             
-            if(iter == NULL) {
-                break;
-            }
-            
-            genome = breeder_iterator_current(iter);
-            count  = 0;
+                scene_critter = scene_first_critter(scene);
             
-            while(genome != NULL && scene_critter != NULL) {
-                critter_genome_transplant(scene_critter, genome);
+                for(idx = 0; idx < champions->count && scene_critter != NULL; ++idx) {
+                    critter_genome_transplant(scene_critter, champions->genome[idx]);
+                    scene_critter = scene_next_critter(scene, scene_critter);
+                }
+                
+                breeder_lock(breeder);
+                printf("update fitness: %10.3f\n", champions->fitness);
+                breeder_unlock(breeder);
                 
-                scene_critter   = scene_next_critter(scene, scene_critter);
-                genome          = breeder_iterator_next(iter);
-                ++count;
+                breeder_champions_free(champions);
             }
-            
-            breeder_iterator_free(iter);
-            
-            printf("update fitness: %10.3f\n", breeder_fitness_n(breeder, count));
-            
-            breeder_unlock(breeder);
         }
+            
+        /* sleep until the next frame (or update) */
+        frame_clock_wait(&clock);
     }
     
+    renderer_free(renderer);
+    tiles_free(tiles);
+    hud_free(hud);
     window_free(window);
     scene_free(scene);
     breeder_free(breeder);
@@ -30,6 +30,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "danger.h"
+#include "sprite.h"
 #include "util.h"
 
 
@@ -38,6 +39,11 @@
 
 #define BOUND 8
 
+/* the sprite of the thing must fit in a sprite_t (see sprite_rasterize()) */
+#if BOUND > SPRITE_MAX_BOUND
+#error "BOUND must not be larger than SPRITE_MAX_BOUND"
+#endif
+
 static bool render_func(void *this_ptr, int x, int y) {
     danger_t *danger;
     int       bound;
@@ -64,6 +70,22 @@ static bool render_func(void *this_ptr, int x, int y) {
     return true;
 }
 
+/* All dangers look the same, so they share one sprite, rasterized the
+ * first time it is needed. */
+static const sprite_t *sprite_func(void *this_ptr) {
+    static sprite_t  sprite;
+    static bool      rasterized = false;
+    danger_t        *danger;
+    
+    if(! rasterized) {
+        danger = (danger_t *)this_ptr;
+        sprite_rasterize(&sprite, &danger->thing);
+        rasterized = true;
+    }
+    
+    return &sprite;
+}
+
 static void update_func(void *this_ptr, float delta, float w, float h) {
     danger_t *danger;
     
@@ -89,6 +111,7 @@ danger_t *danger_new(float x, float y, int dir) {
                 danger,             /* this (self) pointer */
                 render_func,        /* rendering function */
                 NULL,               /* pre-rendering function */
+                sprite_func,        /* sprite function */
                 update_func,        /* position update function */
                 free );             /* finalizer */
         
@@ -60,6 +60,10 @@ static inline void danger_set_position(danger_t *danger, float x, float y) {
     thing_set_position(&danger->thing, x, y);
 }
 
+static inline void danger_set_direction(danger_t *danger, int dir) {
+    boing_set_direction(&danger->boing, dir);
+}
+
 static inline float danger_get_x(danger_t *danger) {
     return thing_get_x(&danger->thing);
 }
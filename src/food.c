@@ -31,6 +31,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "food.h"
+#include "sprite.h"
 #include "util.h"
 
 
@@ -39,6 +40,11 @@
 
 #define BOUND 6
 
+/* the sprite of the thing must fit in a sprite_t (see sprite_rasterize()) */
+#if BOUND > SPRITE_MAX_BOUND
+#error "BOUND must not be larger than SPRITE_MAX_BOUND"
+#endif
+
 static bool render_func(void *this_ptr, int x, int y) {
     food_t *food;
     
@@ -47,6 +53,22 @@ static bool render_func(void *this_ptr, int x, int y) {
     return sqrtf( (float)(x*x + y*y) ) <= food->thing.bound;
 }
 
+/* All food items look the same, so they share one sprite, rasterized the
+ * first time it is needed. */
+static const sprite_t *sprite_func(void *this_ptr) {
+    static sprite_t  sprite;
+    static bool      rasterized = false;
+    food_t          *food;
+    
+    if(! rasterized) {
+        food = (food_t *)this_ptr;
+        sprite_rasterize(&sprite, &food->thing);
+        rasterized = true;
+    }
+    
+    return &sprite;
+}
+
 static void update_func(void *this_ptr, float delta, float w, float h) {
     food_t *food;
     
@@ -72,6 +94,7 @@ food_t *food_new(float x, float y, int dir) {
                 food,               /* this (self) pointer */
                 render_func,        /* rendering function */
                 NULL,               /* pre-rendering function */
+                sprite_func,        /* sprite function */
                 update_func,        /* position update function */
                 free );             /* finalizer */
 
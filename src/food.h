@@ -59,6 +59,10 @@ static inline void food_set_position(food_t *food, float x, float y) {
     thing_set_position(&food->thing, x, y);
 }
 
+static inline void food_set_direction(food_t *food, int dir) {
+    boing_set_direction(&food->boing, dir);
+}
+
 static inline float food_get_x(food_t *food) {
     return thing_get_x(&food->thing);
 }
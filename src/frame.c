@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 199309L /* for clock_gettime() and nanosleep() */
+#include <time.h>
+#include "frame.h"
+
+#define NANOSECONDS_PER_SECOND  1000000000LL
+
+
+/* Monotonic time in nanoseconds, from an arbitrary origin */
+int64_t frame_clock_now(void) {
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return (int64_t)ts.tv_sec * NANOSECONDS_PER_SECOND + ts.tv_nsec;
+}
+
+/* Rate in frames per second */
+void frame_clock_init(frame_clock_t *clock, int rate) {
+    clock->period   = NANOSECONDS_PER_SECOND / rate;
+    clock->deadline = frame_clock_now() + clock->period;
+}
+
+void frame_clock_wait(frame_clock_t *clock) {
+    struct timespec  ts;
+    int64_t          remaining;
+    
+    remaining = clock->deadline - frame_clock_now();
+    
+    while(remaining > 0) {
+        ts.tv_sec   = remaining / NANOSECONDS_PER_SECOND;
+        ts.tv_nsec  = remaining % NANOSECONDS_PER_SECOND;
+        
+        nanosleep(&ts, NULL);
+        
+        /* woken up early by a signal */
+        remaining = clock->deadline - frame_clock_now();
+    }
+    
+    if(remaining < -clock->period) {
+        clock->deadline = frame_clock_now();
+    }
+    
+    clock->deadline += clock->period;
+}
@@ -26,14 +26,99 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ctype.h>
+#include <emmintrin.h>
 #include <malloc.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "genome.h"
 #include "util.h"
 
 
+/* 32-bit FNV-1a hash (see genome_hash()) */
+#define FNV_OFFSET_BASIS    2166136261u
+
+#define FNV_PRIME           16777619u
+
+/* Number of genomes allocated at once when the arena is empty */
+#define ARENA_BLOCK         64
+
+/* Genomes start on a cache line, so the reference counts of genomes used by
+ * different threads never share one */
+#define ARENA_LINE          64
+
+/* Maximum number of mutations of a baby */
+#define MAX_MUTATIONS       10
+
+/* Four xorshift32 generators, one in each lane of an SSE2 register, used by
+ * genome_make_babies() instead of rand(). The numbers are consumed one lane at
+ * a time from the last generated vector. */
+typedef struct {
+    __m128i      state;
+    __m128i      vector;
+    int          available;
+} random_stream_t;
+
+/* First chunk and number of chunks of each hidden gene, all layers together */
+typedef struct {
+    int          genes;
+    int          offset[GENOME_MAX_LAYERS * GENOME_MAX_GENES];
+    int          weights[GENOME_MAX_LAYERS * GENOME_MAX_GENES];
+} gene_table_t;
+
+typedef void (*breed_function_t)(
+        genome_t            *genome,
+        const genome_t      *mommy,
+        const genome_t      *daddy,
+        random_stream_t     *stream,
+        const gene_table_t  *table);
+
+
+static genome_topology_t topology = {
+    .layers         = 1,
+    .layer          = {
+        {
+            .genes      = GENOME_HIDDEN_GENES,
+            .inputs     = GENOME_INPUT_COUNT,
+            .weights    = GENOME_HIDDEN_WEIGHTS,
+            .offset     = 0,
+            .recurrent  = false,
+            .activation = {
+                GENOME_DEFAULT_ACTIVATION(0),
+                GENOME_DEFAULT_ACTIVATION(1),
+                GENOME_DEFAULT_ACTIVATION(2),
+                GENOME_DEFAULT_ACTIVATION(3) }
+        }
+    },
+    .output_inputs  = GENOME_HIDDEN_COUNT,
+    .output_offset  = GENOME_HIDDEN_GENES * GENOME_HIDDEN_WEIGHTS,
+    .chunks         = GENOME_HIDDEN_GENES * GENOME_HIDDEN_WEIGHTS + GENOME_OUTPUT_WEIGHTS,
+    .recurrent      = false
+};
+
+/* Genomes are never returned to the C library. Once freed, they are kept in
+ * this free list and reused. The arena can be accessed by different threads,
+ * e.g. when the graphical user interface frees a critter. */
+static genome_t *arena_free_list = NULL;
+
+/* Blocks allocated for the arena, each one starting with a pointer to the
+ * previous one, so they can be released when the topology changes */
+static void *arena_blocks = NULL;
+
+static pthread_mutex_t arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Identifier of the last genome allocated (protected by arena_mutex) */
+static uint64_t last_id = 0;
+
+/* False if other operators than the default ones were selected with
+ * genome_set_operators() */
+static bool default_operators = true;
+
 static inline float random_weight(void) {
     return 2.0 * GENOME_WEIGHT_AMPLITUDE * ((float)rand() / (float)RAND_MAX - 0.5);
 }
@@ -45,90 +130,183 @@ static inline uint32_t random_colour(void) {
         50 + rand() % 200 );
 }
 
+/* Size of a genome with the chunks of the selected topology */
+static size_t arena_genome_size(void) {
+    size_t size;
+    
+    size = sizeof(genome_t) + topology.chunks * sizeof(gene_chunk_t);
+    
+    return (size + ARENA_LINE - 1) & ~(size_t)(ARENA_LINE - 1);
+}
+
+static bool arena_grow(void) {
+    genome_t   *genome;
+    uint8_t    *block;
+    size_t      size;
+    int         idx;
+    
+    size  = arena_genome_size();
+    block = memalign(ARENA_LINE, ARENA_LINE + ARENA_BLOCK * size);
+    
+    if(block == NULL) {
+        return false;
+    }
+    
+    *(void **)block = arena_blocks;
+    arena_blocks    = block;
+    
+    for(idx = 0; idx < ARENA_BLOCK; ++idx) {
+        genome          = (genome_t *)(block + ARENA_LINE + idx * size);
+        genome->next    = arena_free_list;
+        arena_free_list = genome;
+    }
+    
+    return true;
+}
+
+/* Allocate n genomes at once. Either all of them are allocated or none. */
+bool genome_new_array(genome_t **genomes, int n) {
+    genome_t   *genome;
+    int         idx;
+    
+    pthread_mutex_lock(&arena_mutex);
+    
+    for(idx = 0; idx < n; ++idx) {
+        if(arena_free_list == NULL && !arena_grow()) {
+            while(idx > 0) {
+                genome          = genomes[--idx];
+                genome->next    = arena_free_list;
+                arena_free_list = genome;
+            }
+            
+            pthread_mutex_unlock(&arena_mutex);
+            return false;
+        }
+        
+        genome          = arena_free_list;
+        arena_free_list = genome->next;
+        
+        genome->hash            = 0;
+        genome->id              = ++last_id;
+        genome->fitness_sum     = 0.0;
+        genome->fitness_count   = 0;
+        genome->ref_count       = 1;
+        genome->mutation_step   = GENOME_MUTATION_STEP;
+        genome->next            = NULL;
+        
+        genomes[idx] = genome;
+    }
+    
+    pthread_mutex_unlock(&arena_mutex);
+    
+    return true;
+}
+
 genome_t *genome_new(void) {
     genome_t *genome;
     
-    genome = memalign(16, sizeof(genome_t));
-    
-    if(genome != NULL) {
-        genome->ref_count   = 1;
-        genome->next        = NULL;
+    if(!genome_new_array(&genome, 1)) {
+        return NULL;
     }
     
     return genome;
 }
 
+/* The reference count is atomic because the thread of the breeder clones and
+ * frees genomes of the population without holding the breeder's lock, and so
+ * does the GUI thread with the champions (see breeder_take_champions()). */
 void genome_free(genome_t *genome) {
     if(genome != NULL) {
-        genome->ref_count -= 1;
-        
-        if(genome->ref_count == 0) {
-            free(genome);
+        if(__atomic_sub_fetch(&genome->ref_count, 1, __ATOMIC_ACQ_REL) == 0) {
+            pthread_mutex_lock(&arena_mutex);
+            genome->next    = arena_free_list;
+            arena_free_list = genome;
+            pthread_mutex_unlock(&arena_mutex);
         }
     }
 }
 
 genome_t *genome_clone(genome_t *genome) {
-    genome->ref_count += 1;
+    __atomic_add_fetch(&genome->ref_count, 1, __ATOMIC_RELAXED);
     
     return genome;
 }
 
 void genome_make_random(genome_t *genome) {
-    int idx, idy;
+    gene_chunk_t *chunk;
+    int           idx;
     
-    genome->colour = random_colour();
+    genome->colour          = random_colour();
+    genome->mutation_step   = GENOME_MUTATION_STEP;
         
-    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
-        for(idx = 0; idx < GENOME_HIDDEN_WEIGHTS; ++idx) {
-            genome->hidden[idy].chunk[idx].f[0] = random_weight();
-            genome->hidden[idy].chunk[idx].f[1] = random_weight();
-            genome->hidden[idy].chunk[idx].f[2] = random_weight();
-            genome->hidden[idy].chunk[idx].f[3] = random_weight();
-        }
+    for(idx = 0; idx < topology.output_offset; ++idx) {
+        chunk = &genome->chunk[idx];
+        
+        chunk->f[0] = random_weight();
+        chunk->f[1] = random_weight();
+        chunk->f[2] = random_weight();
+        chunk->f[3] = random_weight();
     }
     
-    for(idx = 0; idx < GENOME_OUTPUT_WEIGHTS; ++idx) {
-        genome->output.chunk[idx].f[0] = random_weight();
-        genome->output.chunk[idx].f[1] = random_weight();
-        genome->output.chunk[idx].f[2] = 0.0;
-        genome->output.chunk[idx].f[3] = 0.0;
+    for(idx = topology.output_offset; idx < topology.chunks; ++idx) {
+        chunk = &genome->chunk[idx];
+        
+        chunk->f[0] = random_weight();
+        chunk->f[1] = random_weight();
+        chunk->f[2] = 0.0;
+        chunk->f[3] = 0.0;
     }
+    
+    genome->hash = genome_hash(genome);
 }
 
-void genome_make_baby(genome_t *genome, const genome_t *mommy, const genome_t *daddy) {
-    int       idx, idy;
-    int       who;
-    int       step;
+static void copy_chunks(genome_t *genome, const genome_t *mommy, const genome_t *daddy, int first, int count) {
+    const genome_t *parent;
+    int             idx;
     
-    for(idy = 0; idy < GENOME_HIDDEN_GENES; ++idy) {
-        who = rand() % 2;
+    if(rand() % 2 == 0) {
+        parent = mommy;
+    }
+    else {
+        parent = daddy;
+    }
     
-        if(who == 0) {
-            for(idx = 0; idx < GENOME_HIDDEN_WEIGHTS; ++idx) {
-                genome->hidden[idy].chunk[idx].v = mommy->hidden[idy].chunk[idx].v;
-            }
-        }
-        else {
-            for(idx = 0; idx < GENOME_HIDDEN_WEIGHTS; ++idx) {
-                genome->hidden[idy].chunk[idx].v = daddy->hidden[idy].chunk[idx].v;
-            }
-        }
+    for(idx = first; idx < first + count; ++idx) {
+        genome->chunk[idx].v = parent->chunk[idx].v;
     }
+}
+
+void genome_make_baby(genome_t *genome, const genome_t *mommy, const genome_t *daddy) {
+    const genome_layer_t *layer;
+    genome_pair_t         parents;
+    int                   idx, idy, idl;
+    int                   genes;
+    int                   who;
+    int                   step;
     
-    who = rand() % 2;
+    /* the other operators are only implemented for genome_make_babies() */
+    if(!default_operators) {
+        parents.mommy = mommy;
+        parents.daddy = daddy;
     
-    if(who == 0) {
-        for(idx = 0; idx < GENOME_OUTPUT_WEIGHTS; ++idx) {
-            genome->output.chunk[idx].v = mommy->output.chunk[idx].v;
-        }
+        genome_make_babies(&genome, &parents, 1);
+        return;
     }
-    else {
-        for(idx = 0; idx < GENOME_OUTPUT_WEIGHTS; ++idx) {
-            genome->output.chunk[idx].v = daddy->output.chunk[idx].v;
+    
+    genes = 0;
+    
+    for(idl = 0; idl < topology.layers; ++idl) {
+        layer = &topology.layer[idl];
+        
+        for(idy = 0; idy < layer->genes; ++idy) {
+            copy_chunks(genome, mommy, daddy, layer->offset + idy * layer->weights, layer->weights);
         }
+        
+        genes += layer->genes;
     }
     
+    copy_chunks(genome, mommy, daddy, topology.output_offset, topology.output_inputs + 1);
+    
     /* mutation */
     for(step = 0; step < 10; ++step) {
         who = rand();
@@ -140,15 +318,22 @@ void genome_make_baby(genome_t *genome, const genome_t *mommy, const genome_t *d
         who >>= 2;
         
         if(who % 32 == 0) {
-            idx = rand() % (4 * GENOME_OUTPUT_WEIGHTS);
+            idx = rand() % (4 * (topology.output_inputs + 1));
             
-            genome->output.f[idx] = random_weight();
+            genome->chunk[topology.output_offset + idx / 4].f[idx % 4] = random_weight();
         }
         else {
-            idy = rand() % GENOME_HIDDEN_GENES;
-            idx = rand() % (4 * GENOME_HIDDEN_WEIGHTS);
+            /* pick a gene uniformly among all hidden layers */
+            idy = rand() % genes;
             
-            genome->hidden[idy].f[idx] = random_weight();
+            for(idl = 0; idy >= topology.layer[idl].genes; ++idl) {
+                idy -= topology.layer[idl].genes;
+            }
+            
+            layer = &topology.layer[idl];
+            idx   = rand() % (4 * layer->weights);
+            
+            genome->chunk[layer->offset + idy * layer->weights + idx / 4].f[idx % 4] = random_weight();
         }
     }
     
@@ -161,58 +346,687 @@ void genome_make_baby(genome_t *genome, const genome_t *mommy, const genome_t *d
     else {
         genome->colour = daddy->colour;
     }
+    
+    genome->mutation_step   = mommy->mutation_step;
+    genome->hash            = genome_hash(genome);
+}
+
+static void random_stream_init(random_stream_t *stream) {
+    /* seeded from rand() so srand() still makes runs reproducible, and never
+     * zero, which is a fixed point of xorshift */
+    stream->state       = _mm_set_epi32(rand() | 1, rand() | 1, rand() | 1, rand() | 1);
+    stream->available   = 0;
+}
+
+/* Four new random numbers, one in each lane */
+static inline __m128i random_stream_vector(random_stream_t *stream) {
+    __m128i x;
+    
+    x = stream->state;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x,  5));
+    
+    stream->state = x;
+    
+    return x;
+}
+
+static inline uint32_t random_stream_next(random_stream_t *stream) {
+    __m128i x;
+    
+    if(stream->available == 0) {
+        stream->vector      = random_stream_vector(stream);
+        stream->available   = 4;
+    }
+    
+    --stream->available;
+    
+    /* lane 0, then shift the next lane in */
+    x = stream->vector;
+    stream->vector = _mm_srli_si128(x, 4);
+    
+    return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+/* Uniform integer between 0 and n - 1, without a division */
+static inline int random_stream_below(random_stream_t *stream, int n) {
+    return (int)(((uint64_t)random_stream_next(stream) * (uint32_t)n) >> 32);
+}
+
+/* Uniform between 0 and 1 */
+static inline float random_stream_unit(random_stream_t *stream) {
+    return (float)(random_stream_next(stream) >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline float random_stream_weight(random_stream_t *stream) {
+    return 2.0 * GENOME_WEIGHT_AMPLITUDE * (random_stream_unit(stream) - 0.5);
+}
+
+/* Approximately normal with mean zero and unit variance: sum of four uniform
+ * numbers, scaled */
+static inline float random_stream_gaussian(random_stream_t *stream) {
+    float sum;
+    
+    sum  = random_stream_unit(stream);
+    sum += random_stream_unit(stream);
+    sum += random_stream_unit(stream);
+    sum += random_stream_unit(stream);
+    
+    return 1.7320508f * (sum - 2.0f);
+}
+
+/* Random mask with each lane all ones or all zeroes */
+static inline __m128 random_stream_mask(random_stream_t *stream) {
+    return _mm_castsi128_ps(_mm_srai_epi32(random_stream_vector(stream), 31));
+}
+
+static inline __m128 bit_mask(uint32_t bits, int bit) {
+    return _mm_castsi128_ps(_mm_set1_epi32(-(int32_t)((bits >> bit) & 1)));
+}
+
+/* From the mommy where the mask is all ones, from the daddy where it is all
+ * zeroes */
+static inline __m128 blend(__m128 mask, __m128 m, __m128 d) {
+    return _mm_or_ps(_mm_and_ps(mask, m), _mm_andnot_ps(mask, d));
+}
+
+/* Crossover of the count chunks of a gene starting at first. For whole-gene
+ * crossover, the parent is selected by bit number bit of bits. */
+static inline __attribute__((always_inline)) void crossover_chunks(
+        int                  crossover,
+        genome_t            *genome,
+        const genome_t      *mommy,
+        const genome_t      *daddy,
+        random_stream_t     *stream,
+        uint32_t             bits,
+        int                  bit,
+        int                  first,
+        int                  count) {
+    
+    __m128  mask;
+    __m128  alpha;
+    __m128  m;
+    __m128  d;
+    int     idx;
+    
+    mask    = _mm_setzero_ps();
+    alpha   = _mm_setzero_ps();
+    
+    switch(crossover) {
+    case GENOME_CROSSOVER_NEURON:
+        mask = random_stream_mask(stream);
+        break;
+    case GENOME_CROSSOVER_BLEND:
+        alpha = _mm_set1_ps(random_stream_unit(stream));
+        break;
+    case GENOME_CROSSOVER_GENE:
+        mask = bit_mask(bits, bit);
+        break;
+    }
+    
+    for(idx = first; idx < first + count; ++idx) {
+        m = _mm_load_ps(mommy->chunk[idx].f);
+        d = _mm_load_ps(daddy->chunk[idx].f);
+        
+        switch(crossover) {
+        case GENOME_CROSSOVER_WEIGHT:
+            _mm_store_ps(genome->chunk[idx].f, blend(random_stream_mask(stream), m, d));
+            break;
+        case GENOME_CROSSOVER_BLEND:
+            _mm_store_ps(genome->chunk[idx].f, _mm_add_ps(d, _mm_mul_ps(alpha, _mm_sub_ps(m, d))));
+            break;
+        default:
+            _mm_store_ps(genome->chunk[idx].f, blend(mask, m, d));
+            break;
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void mutate_weight(int mutation, const genome_t *genome, float *weight, random_stream_t *stream) {
+    float value;
+    
+    if(mutation == GENOME_MUTATION_GAUSSIAN) {
+        value   = *weight + genome->mutation_step * random_stream_gaussian(stream);
+        *weight = fmaxf(-GENOME_WEIGHT_AMPLITUDE, fminf(GENOME_WEIGHT_AMPLITUDE, value));
+    }
+    else {
+        *weight = random_stream_weight(stream);
+    }
+}
+
+/* Make one baby with the given operators. The functions defined below with
+ * BREED_FUNCTION() call this with constant operators, so the compiler makes a
+ * specialized version for each combination. */
+static inline __attribute__((always_inline)) void breed(
+        int                  crossover,
+        int                  mutation,
+        genome_t            *genome,
+        const genome_t      *mommy,
+        const genome_t      *daddy,
+        random_stream_t     *stream,
+        const gene_table_t  *table) {
+    
+    uint32_t    bits;
+    float       step;
+    int         mutations;
+    int         idx, idy;
+    
+    /* one bit per hidden gene (only used for whole-gene crossover), then one
+     * for the output layer and one for the colour */
+    bits = random_stream_next(stream);
+    
+    for(idy = 0; idy < table->genes; ++idy) {
+        crossover_chunks(crossover, genome, mommy, daddy, stream, bits, idy, table->offset[idy], table->weights[idy]);
+    }
+    
+    crossover_chunks(crossover, genome, mommy, daddy, stream, bits, table->genes, topology.output_offset, topology.output_inputs + 1);
+    
+    if((bits >> (table->genes + 1)) & 1) {
+        genome->colour = mommy->colour;
+    }
+    else {
+        genome->colour = daddy->colour;
+    }
+    
+    /* self-adaptive step size: geometric mean of the steps of the parents,
+     * with a log-normal variation */
+    if(mutation == GENOME_MUTATION_GAUSSIAN) {
+        step = sqrtf(mommy->mutation_step * daddy->mutation_step);
+        step = step * expf(GENOME_MUTATION_STEP_RATE * random_stream_gaussian(stream));
+        
+        genome->mutation_step = fmaxf(GENOME_MUTATION_STEP_MIN, fminf(GENOME_MUTATION_STEP_MAX, step));
+    }
+    else {
+        genome->mutation_step = mommy->mutation_step;
+    }
+    
+    /* mutation: each one happens with probability one half, i.e. the number
+     * of trailing zeroes of a random number */
+    mutations = __builtin_ctz(random_stream_next(stream) | (1u << MAX_MUTATIONS));
+    
+    while(mutations-- > 0) {
+        if(random_stream_next(stream) >> 27 == 0) {
+            idx = random_stream_below(stream, 4 * (topology.output_inputs + 1));
+            
+            mutate_weight(mutation, genome, &genome->chunk[topology.output_offset + idx / 4].f[idx % 4], stream);
+        }
+        else {
+            idy = random_stream_below(stream, table->genes);
+            idx = random_stream_below(stream, 4 * table->weights[idy]);
+            
+            mutate_weight(mutation, genome, &genome->chunk[table->offset[idy] + idx / 4].f[idx % 4], stream);
+        }
+    }
+    
+    genome->hash = genome_hash(genome);
+}
+
+#define BREED_FUNCTION(crossover, mutation) \
+    static void breed_##crossover##_##mutation( \
+            genome_t            *genome, \
+            const genome_t      *mommy, \
+            const genome_t      *daddy, \
+            random_stream_t     *stream, \
+            const gene_table_t  *table) { \
+        breed(GENOME_CROSSOVER_##crossover, GENOME_MUTATION_##mutation, genome, mommy, daddy, stream, table); \
+    }
+
+#define BREED_FUNCTION_ENTRY(crossover, mutation) \
+    [GENOME_CROSSOVER_##crossover][GENOME_MUTATION_##mutation] = breed_##crossover##_##mutation
+
+BREED_FUNCTION(GENE,    REPLACE)
+BREED_FUNCTION(GENE,    GAUSSIAN)
+BREED_FUNCTION(NEURON,  REPLACE)
+BREED_FUNCTION(NEURON,  GAUSSIAN)
+BREED_FUNCTION(WEIGHT,  REPLACE)
+BREED_FUNCTION(WEIGHT,  GAUSSIAN)
+BREED_FUNCTION(BLEND,   REPLACE)
+BREED_FUNCTION(BLEND,   GAUSSIAN)
+
+static const breed_function_t breed_functions[GENOME_CROSSOVER_COUNT][GENOME_MUTATION_COUNT] = {
+    BREED_FUNCTION_ENTRY(GENE,      REPLACE),
+    BREED_FUNCTION_ENTRY(GENE,      GAUSSIAN),
+    BREED_FUNCTION_ENTRY(NEURON,    REPLACE),
+    BREED_FUNCTION_ENTRY(NEURON,    GAUSSIAN),
+    BREED_FUNCTION_ENTRY(WEIGHT,    REPLACE),
+    BREED_FUNCTION_ENTRY(WEIGHT,    GAUSSIAN),
+    BREED_FUNCTION_ENTRY(BLEND,     REPLACE),
+    BREED_FUNCTION_ENTRY(BLEND,     GAUSSIAN)
+};
+
+static const char *crossover_names[GENOME_CROSSOVER_COUNT] = {
+    [GENOME_CROSSOVER_GENE]     = "gene",
+    [GENOME_CROSSOVER_NEURON]   = "neuron",
+    [GENOME_CROSSOVER_WEIGHT]   = "weight",
+    [GENOME_CROSSOVER_BLEND]    = "blend"
+};
+
+static const char *mutation_names[GENOME_MUTATION_COUNT] = {
+    [GENOME_MUTATION_REPLACE]   = "replace",
+    [GENOME_MUTATION_GAUSSIAN]  = "gaussian"
+};
+
+/* Operators selected with genome_set_operators() */
+static breed_function_t breed_function = breed_GENE_REPLACE;
+
+/* Same as genome_make_baby() for n babies at once, but with a faster random
+ * number generator. With the default operators, the probability distribution
+ * of crossover and mutations is the same as for genome_make_baby(). */
+void genome_make_babies(genome_t **babies, const genome_pair_t *parents, int n) {
+    const genome_layer_t *layer;
+    random_stream_t       stream;
+    gene_table_t          table;
+    int                   idy, idl;
+    int                   idb;
+    
+    random_stream_init(&stream);
+    
+    table.genes = 0;
+    
+    for(idl = 0; idl < topology.layers; ++idl) {
+        layer = &topology.layer[idl];
+        
+        for(idy = 0; idy < layer->genes; ++idy) {
+            table.offset[table.genes]   = layer->offset + idy * layer->weights;
+            table.weights[table.genes]  = layer->weights;
+            ++table.genes;
+        }
+    }
+    
+    for(idb = 0; idb < n; ++idb) {
+        if(idb + 1 < n) {
+            __builtin_prefetch(parents[idb + 1].mommy);
+            __builtin_prefetch(parents[idb + 1].daddy);
+        }
+        
+        breed_function(babies[idb], parents[idb].mommy, parents[idb].daddy, &stream, &table);
+    }
+}
+
+/* Parse an operators specification: the name of the crossover operator, a
+ * slash, then the name of the mutation operator, e.g. "gene/replace" (the
+ * default) or "blend/gaussian". */
+bool genome_operators_parse(const char *spec, int *crossover, int *mutation) {
+    const char  *slash;
+    size_t       length;
+    int          idx;
+    
+    slash = strchr(spec, '/');
+    
+    if(slash == NULL) {
+        return false;
+    }
+    
+    length      = slash - spec;
+    *crossover  = -1;
+    *mutation   = -1;
+    
+    for(idx = 0; idx < GENOME_CROSSOVER_COUNT; ++idx) {
+        if(strlen(crossover_names[idx]) == length && strncmp(spec, crossover_names[idx], length) == 0) {
+            *crossover = idx;
+        }
+    }
+    
+    for(idx = 0; idx < GENOME_MUTATION_COUNT; ++idx) {
+        if(strcmp(slash + 1, mutation_names[idx]) == 0) {
+            *mutation = idx;
+        }
+    }
+    
+    return *crossover >= 0 && *mutation >= 0;
+}
+
+/* Select the operators used by genome_make_babies() and genome_make_baby().
+ * This only looks up the specialized function for these operators, so
+ * breeding itself does not test them. */
+void genome_set_operators(int crossover, int mutation) {
+    breed_function      = breed_functions[crossover][mutation];
+    default_operators   = (crossover == GENOME_CROSSOVER_GENE && mutation == GENOME_MUTATION_REPLACE);
+}
+
+static void neuron_name(char *name, int idl, int idx) {
+    char type;
+    
+    if(topology.layer[idl].activation[idx / 4] == GENOME_GAUSSIAN) {
+        type = 'G';
+    }
+    else {
+        type = 'H';
+    }
+    
+    if(topology.layers == 1) {
+        sprintf(name, "[%c%u]", type, idx);
+    }
+    else {
+        sprintf(name, "[%c%u.%u]", type, idl, idx);
+    }
 }
 
 void genome_dump(const genome_t *genome) {
+    static const char *input_names[GENOME_INPUT_COUNT] = {
+        "food_intensity",
+        "food_angle",
+        "danger_intensity",
+        "danger_angle",
+        "wall_intensity",
+        "wall_angle",
+        "food_odour",
+        "danger_odour" };
+    
+    const gene_chunk_t *chunk;
     char name[32];
-    int idx, idy;
+    int idx, idy, idl, idn;
+    
+    for(idl = 0; idl < topology.layers; ++idl) {
+        printf("\n");
+    
+        if(topology.layers == 1) {
+            printf("Hidden layer:\n");
+        }
+        else {
+            printf("Hidden layer %u:\n", idl);
+        }
+        
+        printf("--------------------------------------------------------------------------\n");
+        
+        for(idx = 0; idx < topology.layer[idl].genes; ++idx) {
+            chunk = genome_hidden(genome, &topology, idl, idx);
+            
+            for(idy = 0; idy < 4; ++idy) {
+                neuron_name(name, idl, 4 * idx + idy);
+                
+                printf("    %-16s --> %10.5f --> neuron %s\n", "[1]", chunk[0].f[idy], name);
+                
+                for(idn = 0; idn < topology.layer[idl].inputs; ++idn) {
+                    if(idl == 0) {
+                        printf("    %-16s --> %10.5f\n", input_names[idn], chunk[idn + 1].f[idy]);
+                    }
+                    else {
+                        neuron_name(name, idl - 1, idn);
+                        printf("    %-16s --> %10.5f\n", name, chunk[idn + 1].f[idy]);
+                    }
+                }
+                
+                /* recurrent inputs, i.e. activations of the previous step */
+                if(topology.layer[idl].recurrent) {
+                    for(idn = 0; idn < 4 * topology.layer[idl].genes; ++idn) {
+                        neuron_name(name, idl, idn);
+                        strcat(name, "'");
+                        printf("    %-16s --> %10.5f\n", name, chunk[topology.layer[idl].inputs + 1 + idn].f[idy]);
+                    }
+                }
+                
+                printf("--------------------------------------------------------------------------\n");
+            }
+        }
+    }
     
     printf("\n");
-    printf("Hidden layer:\n");
+    printf("Output layer:\n");
     printf("--------------------------------------------------------------------------\n");
     
-    for(idx = 0; idx < GENOME_HIDDEN_GENES; ++idx) {        
+    chunk = genome_output(genome, &topology);
+    
+    for(idy = 0; idy < GENOME_OUTPUT_COUNT; ++idy) {
+        printf("    %-16s --> %10.5f --> neuron [Y%u]\n", "[1]", chunk[0].f[idy], idy);
+        
+        for(idx = 1; idx < topology.output_inputs + 1; ++idx) {
+            neuron_name(name, topology.layers - 1, idx - 1);
+            
+            printf("    %-16s --> %10.5f\n", name, chunk[idx].f[idy]);
+        }
+        
+        printf("--------------------------------------------------------------------------\n");
+    }
+}
+
+/* FNV-1a over 32-bit words instead of bytes, with one independent hash for
+ * each of the four lanes of the chunks so the multiplications can overlap,
+ * folded together at the end. */
+uint32_t genome_hash(const genome_t *genome) {
+    uint32_t        words[4];
+    uint32_t        lane[4];
+    uint32_t        hash;
+    int             idx, idy;
+    
+    for(idy = 0; idy < 4; ++idy) {
+        lane[idy] = FNV_OFFSET_BASIS + idy;
+    }
+    
+    for(idx = 0; idx < topology.chunks; ++idx) {
+        memcpy(words, genome->chunk[idx].f, sizeof(words));
+        
         for(idy = 0; idy < 4; ++idy) {
-            if(idx < GENOME_GAUSSIAN_GENES) {
-                sprintf(name, "[G%u]", 4 * idx + idy);
-            }
-            else {
-                sprintf(name, "[H%u]", 4 * idx + idy);
+            lane[idy] = (lane[idy] ^ words[idy]) * FNV_PRIME;
+        }
+    }
+    
+    hash = FNV_OFFSET_BASIS;
+    
+    for(idy = 0; idy < 4; ++idy) {
+        hash = (hash ^ lane[idy]) * FNV_PRIME;
+    }
+    
+    return (hash ^ genome->colour) * FNV_PRIME;
+}
+
+bool genome_equal(const genome_t *genome1, const genome_t *genome2) {
+    if(genome1->hash != genome2->hash) {
+        return false;
+    }
+    
+    if(genome1->colour != genome2->colour) {
+        return false;
+    }
+    
+    return memcmp(genome1->chunk, genome2->chunk, topology.chunks * sizeof(gene_chunk_t)) == 0;
+}
+
+/* Parse a topology specification: hidden layers separated by slashes, each
+ * layer being a list of neuron counts, each followed by the letter of their
+ * activation function: s (sigmoid), g (gaussian) or r (ReLU). Counts must be
+ * multiples of four. A layer followed by a plus sign is recurrent. For
+ * example, the default topology is "8r", "4s4r/4r" is two hidden layers, one
+ * of eight neurons, then one of four, and "8r+" is a single recurrent hidden
+ * layer. */
+bool genome_topology_parse(genome_topology_t *topology, const char *spec) {
+    genome_layer_t *layer;
+    char           *end;
+    long            count;
+    int             type;
+    int             inputs;
+    int             offset;
+    
+    memset(topology, 0, sizeof(genome_topology_t));
+    
+    inputs = GENOME_INPUT_COUNT;
+    offset = 0;
+    
+    while(true) {
+        if(topology->layers == GENOME_MAX_LAYERS) {
+            return false;
+        }
+        
+        layer           = &topology->layer[topology->layers++];
+        layer->inputs   = inputs;
+        layer->offset   = offset;
+        
+        do {
+            if(!isdigit((unsigned char)*spec)) {
+                return false;
             }
             
-            printf("    %-16s --> %10.5f --> neuron %s\n",   "[1]",                genome->hidden[idx].chunk[0].f[idy], name);
+            count = strtol(spec, &end, 10);
+            spec  = end;
             
-            printf("    %-16s --> %10.5f\n",                 "food_intensity",     genome->hidden[idx].chunk[1].f[idy]);
-            printf("    %-16s --> %10.5f\n",                 "food_angle",         genome->hidden[idx].chunk[2].f[idy]);
-            printf("    %-16s --> %10.5f\n",                 "danger_intensity",   genome->hidden[idx].chunk[3].f[idy]);
-            printf("    %-16s --> %10.5f\n",                 "danger_angle",       genome->hidden[idx].chunk[4].f[idy]);
-            printf("    %-16s --> %10.5f\n",                 "wall_intensity",     genome->hidden[idx].chunk[5].f[idy]);
-            printf("    %-16s --> %10.5f\n",                 "wall_angle",         genome->hidden[idx].chunk[6].f[idy]);
-            printf("    %-16s --> %10.5f\n",                 "food_odour",         genome->hidden[idx].chunk[7].f[idy]);
-            printf("    %-16s --> %10.5f\n",                 "danger_odour",       genome->hidden[idx].chunk[8].f[idy]);
+            switch(*spec++) {
+            case 's':
+                type = GENOME_SIGMOID;
+                break;
+            case 'g':
+                type = GENOME_GAUSSIAN;
+                break;
+            case 'r':
+                type = GENOME_RELU;
+                break;
+            default:
+                return false;
+            }
+            
+            if(count % 4 != 0 || layer->genes + count / 4 > GENOME_MAX_GENES) {
+                return false;
+            }
             
-            printf("--------------------------------------------------------------------------\n");
+            while(count > 0) {
+                layer->activation[layer->genes++] = type;
+                count -= 4;
+            }
+        } while(*spec != '\0' && *spec != '/' && *spec != '+');
+        
+        if(layer->genes == 0) {
+            return false;
+        }
+        
+        if(*spec == '+') {
+            layer->recurrent    = true;
+            topology->recurrent = true;
+            ++spec;
+        }
+        
+        layer->weights  = layer->inputs + 1;
+        
+        if(layer->recurrent) {
+            layer->weights += 4 * layer->genes;
+        }
+        
+        inputs  = 4 * layer->genes;
+        offset += layer->genes * layer->weights;
+        
+        if(*spec == '\0') {
+            break;
+        }
+        
+        if(*spec++ != '/') {
+            return false;
         }
     }
     
-    printf("\n");
-    printf("Output layer:\n");
-    printf("--------------------------------------------------------------------------\n");
+    topology->output_inputs = inputs;
+    topology->output_offset = offset;
+    topology->chunks        = offset + inputs + 1;
     
-    for(idy = 0; idy < GENOME_OUTPUT_COUNT; ++idy) {
-        printf("    %-16s --> %10.5f --> neuron [Y%u]\n", "[1]", genome->output.chunk[0].f[idy], idy);
+    return true;
+}
+
+bool genome_topology_equal(const genome_topology_t *topology1, const genome_topology_t *topology2) {
+    const genome_layer_t *layer1;
+    const genome_layer_t *layer2;
+    int                   idx, idl;
+    
+    if(     topology1->layers != topology2->layers ||
+            topology1->output_inputs != topology2->output_inputs ||
+            topology1->output_offset != topology2->output_offset ||
+            topology1->chunks != topology2->chunks) {
+        return false;
+    }
+    
+    for(idl = 0; idl < topology1->layers; ++idl) {
+        layer1 = &topology1->layer[idl];
+        layer2 = &topology2->layer[idl];
         
-        for(idx = 1; idx < GENOME_OUTPUT_WEIGHTS; ++idx) {
-            if(idx < GENOME_HIDDEN_GAUSSIAN + 1) {
-                sprintf(name, "[G%u]", idx - 1);
+        if(     layer1->genes != layer2->genes ||
+                layer1->inputs != layer2->inputs ||
+                layer1->weights != layer2->weights ||
+                layer1->offset != layer2->offset ||
+                layer1->recurrent != layer2->recurrent) {
+            return false;
+        }
+        
+        for(idx = 0; idx < layer1->genes; ++idx) {
+            if(layer1->activation[idx] != layer2->activation[idx]) {
+                return false;
             }
-            else {
-                sprintf(name, "[H%u]", idx - 1);
+        }
+    }
+    
+    return true;
+}
+
+/* Check a topology that does not come from genome_topology_parse(), e.g. one
+ * read from a file: it must be within the limits of GENOME_MAX_LAYERS and
+ * GENOME_MAX_GENES, and all its fields must be consistent with the genes and
+ * recurrence of its layers. */
+bool genome_topology_valid(const genome_topology_t *topology) {
+    const genome_layer_t *layer;
+    bool                  recurrent;
+    int                   inputs;
+    int                   offset;
+    int                   idx, idl;
+    
+    if(topology->layers < 1 || topology->layers > GENOME_MAX_LAYERS) {
+        return false;
+    }
+    
+    inputs      = GENOME_INPUT_COUNT;
+    offset      = 0;
+    recurrent   = false;
+    
+    for(idl = 0; idl < topology->layers; ++idl) {
+        layer = &topology->layer[idl];
+        
+        if(layer->genes < 1 || layer->genes > GENOME_MAX_GENES) {
+            return false;
+        }
+        
+        for(idx = 0; idx < layer->genes; ++idx) {
+            if(layer->activation[idx] > GENOME_RELU) {
+                return false;
             }
-            
-            printf("    %-16s --> %10.5f\n", name, genome->output.chunk[idx].f[idy]);
         }
         
-        printf("--------------------------------------------------------------------------\n");
+        if(     layer->inputs != inputs ||
+                layer->offset != offset ||
+                layer->weights != inputs + 1 + (layer->recurrent ? 4 * layer->genes : 0)) {
+            return false;
+        }
+        
+        recurrent   = recurrent || layer->recurrent;
+        inputs      = 4 * layer->genes;
+        offset     += layer->genes * layer->weights;
+    }
+    
+    return  topology->output_inputs == inputs &&
+            topology->output_offset == offset &&
+            topology->chunks == offset + inputs + 1 &&
+            topology->chunks <= GENOME_MAX_CHUNKS &&
+            topology->recurrent == recurrent;
+}
+
+/* Must not be called once genomes exist. Use brain_set_topology() instead so
+ * the brain is computed accordingly. */
+void genome_set_topology(const genome_topology_t *new_topology) {
+    void *block;
+    
+    /* the genomes of the arena are too small or too large for the new
+     * topology */
+    if(new_topology->chunks != topology.chunks) {
+        pthread_mutex_lock(&arena_mutex);
+        
+        while(arena_blocks != NULL) {
+            block           = arena_blocks;
+            arena_blocks    = *(void **)block;
+            free(block);
+        }
+        
+        arena_free_list = NULL;
+        
+        pthread_mutex_unlock(&arena_mutex);
     }
+    
+    topology = *new_topology;
+}
+
+const genome_topology_t *genome_get_topology(void) {
+    return &topology;
 }
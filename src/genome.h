@@ -29,8 +29,13 @@
 #ifndef _CRITTERS_GENOME_H_
 #define _CRITTERS_GENOME_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* Default topology of the brain, i.e. unless another one is selected at run
+ * time with genome_set_topology(): a single hidden layer with the following
+ * neurons. */
+
 /* Number of neurons with a sigmoid-like activation function in the hidden layer.
  * Must be a multiple of four. Can be zero. */
 #define GENOME_HIDDEN_SIGMOID   0
@@ -46,6 +51,27 @@
 /* All weights are between plus or minus this value. */
 #define GENOME_WEIGHT_AMPLITUDE 20.0
 
+/* Gaussian mutation (GENOME_MUTATION_GAUSSIAN): standard deviation of the
+ * perturbation of the weights of novel genomes. The babies inherit the step
+ * size of their parents, which evolves along with the weights. */
+#define GENOME_MUTATION_STEP        2.0
+
+/* Gaussian mutation: the step size of a baby is the one of its parents times
+ * exp(N(0, 1) * this rate) */
+#define GENOME_MUTATION_STEP_RATE   0.3
+
+/* Gaussian mutation: bounds of the step size */
+#define GENOME_MUTATION_STEP_MIN    0.05
+
+#define GENOME_MUTATION_STEP_MAX    GENOME_WEIGHT_AMPLITUDE
+
+/* Maximum number of hidden layers of a topology */
+#define GENOME_MAX_LAYERS       3
+
+/* Maximum number of genes (i.e. groups of four neurons) in a hidden layer of
+ * a topology */
+#define GENOME_MAX_GENES        4
+
 
 #define GENOME_HIDDEN_COUNT     (GENOME_HIDDEN_SIGMOID + GENOME_HIDDEN_GAUSSIAN + GENOME_HIDDEN_RELU)
 
@@ -66,9 +92,59 @@
 
 #define GENOME_OUTPUT_WEIGHTS   (GENOME_HIDDEN_COUNT + 1)
 
+/* Number of chunks needed for the largest topology: the first hidden layer,
+ * the other hidden layers (all of them recurrent) and the output layer. */
+#define GENOME_MAX_CHUNKS       (GENOME_MAX_GENES * (GENOME_HIDDEN_WEIGHTS + 4 * GENOME_MAX_GENES) + \
+                                 (GENOME_MAX_LAYERS - 1) * GENOME_MAX_GENES * (8 * GENOME_MAX_GENES + 1) + \
+                                 4 * GENOME_MAX_GENES + 1)
+
+#if GENOME_HIDDEN_GENES > GENOME_MAX_GENES
+#error "Default hidden layer has more than GENOME_MAX_GENES genes"
+#endif
+
+/* Activation functions of hidden neurons */
+#define GENOME_SIGMOID          0
+
+#define GENOME_GAUSSIAN         1
+
+#define GENOME_RELU             2
+
+/* Crossover operators (see genome_set_operators()) */
+#define GENOME_CROSSOVER_GENE       0   /* each gene from either parent */
+
+#define GENOME_CROSSOVER_NEURON     1   /* each neuron (all its weights) from either parent */
+
+#define GENOME_CROSSOVER_WEIGHT     2   /* each weight from either parent */
+
+#define GENOME_CROSSOVER_BLEND      3   /* each gene a random weighted average of both parents */
+
+#define GENOME_CROSSOVER_COUNT      4
+
+/* Mutation operators */
+#define GENOME_MUTATION_REPLACE     0   /* new random weight */
+
+#define GENOME_MUTATION_GAUSSIAN    1   /* gaussian perturbation of the weight */
+
+#define GENOME_MUTATION_COUNT       2
+
+/* Activation function of gene idy of the hidden layer of the default topology */
+#define GENOME_DEFAULT_ACTIVATION(idy) \
+    ((idy) < GENOME_SIGMOID_GENES ? GENOME_SIGMOID : \
+     (idy) < GENOME_SIGMOID_GENES + GENOME_GAUSSIAN_GENES ? GENOME_GAUSSIAN : GENOME_RELU)
+
+
+typedef struct genome_layer_t genome_layer_t;
+
+typedef struct genome_topology_t genome_topology_t;
 
 typedef struct genome_t genome_t;
 
+/* Parents of a baby, for genome_make_babies() */
+typedef struct {
+    const genome_t  *mommy;
+    const genome_t  *daddy;
+} genome_pair_t;
+
 /* A vector of four 32-bit floating-point values */
 typedef float genome_f4_t __attribute__ ((vector_size (16)));
 
@@ -78,26 +154,54 @@ typedef union {
     float       f[4];
 } gene_chunk_t __attribute__ ((aligned (16)));
 
-typedef union gene_hidden_t {
-    gene_chunk_t    chunk[GENOME_HIDDEN_WEIGHTS];
-    float           f[4 * GENOME_HIDDEN_WEIGHTS];
-} gene_hidden_t;
-
-typedef union  {
-    gene_chunk_t    chunk[GENOME_OUTPUT_WEIGHTS];
-    float           f[4 * GENOME_OUTPUT_WEIGHTS];
-} gene_output_t;
-
+/* The weights of each hidden layer, then those of the output layer, are
+ * stored one after the other in the chunks of the genome (see
+ * genome_topology_t). For each hidden layer, the weights are grouped by gene.
+ * Each gene starts with the bias chunk, followed by one chunk per input, where
+ * each chunk holds the weights of four neurons. The output layer uses the same
+ * layout, for its two neurons only (the upper half of each chunk is unused).
+ * In a recurrent hidden layer, each gene has additional chunks after those of
+ * the inputs, one for each neuron of the layer, for the activations of the
+ * previous step. */
 struct genome_t {
-    gene_hidden_t    hidden[GENOME_HIDDEN_GENES];
-    gene_output_t    output;
     uint32_t         colour;
+    uint32_t         hash;
+    uint64_t         id;            /* unique, e.g. for the lineage file */
+    float            mutation_step; /* for GENOME_MUTATION_GAUSSIAN */
+    float            fitness_sum;
+    int              fitness_count;
     int              ref_count;
-    genome_t        *next;
+    genome_t        *next;          /* free list of the genome arena */
+    /* The colour and the chunks are the genome proper, i.e. they are covered
+     * by genome_hash() and genome_equal(). Genomes are allocated with as many
+     * chunks as the selected topology uses (see genome_set_topology()). */
+    gene_chunk_t     chunk[];
 } __attribute__ ((aligned (16)));
 
+struct genome_layer_t {
+    int              genes;         /* groups of four neurons */
+    int              inputs;        /* inputs of each neuron, bias and recurrent inputs excluded */
+    int              weights;       /* chunks of each gene */
+    int              offset;        /* index of the first chunk of the layer */
+    bool             recurrent;
+    uint8_t          activation[GENOME_MAX_GENES];
+};
+
+/* Topology of the brain. All genomes share the same topology, which must be
+ * selected (if not the default one) before the first genome is created. */
+struct genome_topology_t {
+    int              layers;        /* hidden layers */
+    genome_layer_t   layer[GENOME_MAX_LAYERS];
+    int              output_inputs; /* neurons of the last hidden layer */
+    int              output_offset; /* index of the first chunk of the output layer */
+    int              chunks;        /* number of chunks used */
+    bool             recurrent;     /* true if any hidden layer is recurrent */
+};
+
 genome_t *genome_new(void);
 
+bool genome_new_array(genome_t **genomes, int n);
+
 void genome_free(genome_t *genome);
 
 genome_t *genome_clone(genome_t *genome);
@@ -106,6 +210,53 @@ void genome_make_random(genome_t *genome);
 
 void genome_make_baby(genome_t *genome, const genome_t *mommy, const genome_t *daddy);
 
+void genome_make_babies(genome_t **babies, const genome_pair_t *parents, int n);
+
 void genome_dump(const genome_t *genome);
 
+uint32_t genome_hash(const genome_t *genome);
+
+bool genome_equal(const genome_t *genome1, const genome_t *genome2);
+
+bool genome_topology_parse(genome_topology_t *topology, const char *spec);
+
+bool genome_topology_equal(const genome_topology_t *topology1, const genome_topology_t *topology2);
+
+bool genome_topology_valid(const genome_topology_t *topology);
+
+void genome_set_topology(const genome_topology_t *topology);
+
+const genome_topology_t *genome_get_topology(void);
+
+bool genome_operators_parse(const char *spec, int *crossover, int *mutation);
+
+void genome_set_operators(int crossover, int mutation);
+
+/* Chunks of gene idy of hidden layer idl: bias, then inputs, then recurrent
+ * inputs */
+static inline const gene_chunk_t *genome_hidden(const genome_t *genome, const genome_topology_t *topology, int idl, int idy) {
+    const genome_layer_t *layer = &topology->layer[idl];
+    
+    return &genome->chunk[layer->offset + idy * layer->weights];
+}
+
+/* Chunks of the output layer: bias, then inputs */
+static inline const gene_chunk_t *genome_output(const genome_t *genome, const genome_topology_t *topology) {
+    return &genome->chunk[topology->output_offset];
+}
+
+static inline void genome_add_fitness(genome_t *genome, float fitness) {
+    genome->fitness_sum   += fitness;
+    genome->fitness_count += 1;
+}
+
+/* Average of all fitness scores recorded for this genome. */
+static inline float genome_fitness(const genome_t *genome) {
+    if(genome->fitness_count == 0) {
+        return 0.0;
+    }
+    
+    return genome->fitness_sum / (float)genome->fitness_count;
+}
+
 #endif
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <quatre/macros.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "frame.h"
+#include "hud.h"
+#include "util.h"
+
+#define HUD_LINES           6
+
+#define HUD_COLUMNS         24
+
+/* The glyphs are 5 x 7 pixels, in cells of 6 x 9 pixels */
+#define GLYPH_WIDTH         5
+
+#define GLYPH_HEIGHT        7
+
+#define CELL_WIDTH          6
+
+#define CELL_HEIGHT         9
+
+#define PADDING             4
+
+#define HUD_WIDTH           (2 * PADDING + HUD_COLUMNS * CELL_WIDTH)
+
+#define HUD_HEIGHT          (2 * PADDING + HUD_LINES * CELL_HEIGHT - (CELL_HEIGHT - GLYPH_HEIGHT))
+
+/* The utilisation of each thread is a bar on the last line */
+#define BARS_COLUMN         8
+
+#define BAR_WIDTH           5
+
+#define COLOUR_HUD_BG       rgb(0, 0, 0)
+
+#define COLOUR_HUD_TEXT     rgb(200, 200, 200)
+
+#define COLOUR_HUD_BAR      rgb(80, 200, 80)
+
+#define COLOUR_HUD_BAR_BG   rgb(60, 60, 60)
+
+#define NANOSECONDS_PER_SECOND  1e9
+
+
+/* Overlay with the frame time of the GUI and the throughput of the breeder.
+ * The rates are computed from the counters of the breeder (see
+ * breeder_get_stats()) once per HUD_PERIOD and formatted into the text, which
+ * is drawn in each frame. Nothing is allocated after hud_new(). */
+struct hud_t {
+    breeder_t       *breeder;
+    breeder_stats_t  stats;
+    int64_t          period_start;
+    int64_t          work;
+    int              frames;
+    int              thread_n;
+    float            utilisation[BREEDER_STATS_THREADS];
+    char             text[HUD_LINES][HUD_COLUMNS + 1];
+};
+
+/* Each row of a glyph is 5 bits, leftmost pixel first */
+static const uint8_t font[128][GLYPH_HEIGHT] = {
+    ['0'] = {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e},
+    ['1'] = {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e},
+    ['2'] = {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f},
+    ['3'] = {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e},
+    ['4'] = {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02},
+    ['5'] = {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e},
+    ['6'] = {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e},
+    ['7'] = {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+    ['8'] = {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e},
+    ['9'] = {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c},
+    ['A'] = {0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11},
+    ['B'] = {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e},
+    ['C'] = {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e},
+    ['D'] = {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c},
+    ['E'] = {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f},
+    ['F'] = {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10},
+    ['G'] = {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f},
+    ['H'] = {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11},
+    ['I'] = {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e},
+    ['J'] = {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c},
+    ['K'] = {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},
+    ['L'] = {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f},
+    ['M'] = {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11},
+    ['N'] = {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+    ['O'] = {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e},
+    ['P'] = {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10},
+    ['Q'] = {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d},
+    ['R'] = {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11},
+    ['S'] = {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e},
+    ['T'] = {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+    ['U'] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e},
+    ['V'] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04},
+    ['W'] = {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a},
+    ['X'] = {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11},
+    ['Y'] = {0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04},
+    ['Z'] = {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f},
+    ['.'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c},
+    [':'] = {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00},
+    ['/'] = {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00},
+    ['%'] = {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03},
+    ['-'] = {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}
+};
+
+/* Compute the rates over the period that just ended and format them */
+static void update(hud_t *hud, int64_t now) {
+    breeder_stats_t  stats;
+    double           seconds;
+    double           frame_ms;
+    double           microseconds;
+    int              idx;
+    
+    breeder_get_stats(hud->breeder, &stats);
+    
+    seconds         = (double)(now - hud->period_start) / NANOSECONDS_PER_SECOND;
+    microseconds    = seconds * 1e6;
+    frame_ms        = (hud->frames > 0) ? (double)hud->work / hud->frames / 1e6 : 0.0;
+    
+    snprintf(hud->text[0], sizeof(hud->text[0]), "FRAME %5.2f MS %4.0f FPS", frame_ms, hud->frames / seconds);
+    snprintf(hud->text[1], sizeof(hud->text[1]), "STEPS/S       %10.0f", (stats.scene_steps - hud->stats.scene_steps) / seconds);
+    snprintf(hud->text[2], sizeof(hud->text[2]), "GENERATIONS/S %10.1f", (stats.generations - hud->stats.generations) / seconds);
+    snprintf(hud->text[3], sizeof(hud->text[3]), "GENOMES/S     %10.0f", (stats.genomes - hud->stats.genomes) / seconds);
+    snprintf(hud->text[4], sizeof(hud->text[4]), "LOCK WAIT %7.2f MS/S", (stats.lock_wait - hud->stats.lock_wait) / 1e3 / seconds);
+    snprintf(hud->text[5], sizeof(hud->text[5]), "THREADS");
+    
+    for(idx = 0; idx < stats.thread_n; ++idx) {
+        hud->utilisation[idx] = (float)((stats.busy[idx] - hud->stats.busy[idx]) / microseconds);
+    }
+    
+    hud->thread_n       = stats.thread_n;
+    hud->stats          = stats;
+    hud->period_start   = now;
+    hud->work           = 0;
+    hud->frames         = 0;
+}
+
+hud_t *hud_new(breeder_t *breeder) {
+    hud_t   *hud;
+    int      idx;
+    
+    hud = qrt_new(hud_t);
+    
+    if(hud == NULL) {
+        return NULL;
+    }
+    
+    hud->breeder        = breeder;
+    hud->period_start   = frame_clock_now();
+    hud->work           = 0;
+    hud->frames         = 0;
+    hud->thread_n       = 0;
+    
+    breeder_get_stats(breeder, &hud->stats);
+    
+    for(idx = 0; idx < HUD_LINES; ++idx) {
+        hud->text[idx][0] = '\0';
+    }
+    
+    return hud;
+}
+
+void hud_free(hud_t *hud) {
+    free(hud);
+}
+
+/* Account for a frame of the GUI, where work is the time spent updating and
+ * rendering, in nanoseconds */
+void hud_add_frame(hud_t *hud, int64_t work) {
+    hud->work += work;
+    ++hud->frames;
+}
+
+/* Fill a rectangle, clipped to the HUD */
+static void fill(SDL_Surface *screen, const SDL_Rect *clip, int x, int y, int w, int h, Uint32 colour) {
+    Uint32  *row;
+    int      x1, y1;
+    int      x2, y2;
+    int      idx, idy;
+    
+    x1 = (x > clip->x) ? x : clip->x;
+    y1 = (y > clip->y) ? y : clip->y;
+    x2 = (x + w < clip->x + clip->w) ? x + w : clip->x + clip->w;
+    y2 = (y + h < clip->y + clip->h) ? y + h : clip->y + clip->h;
+    
+    for(idy = y1; idy < y2; ++idy) {
+        row = (Uint32 *)((Uint8 *)screen->pixels + idy * screen->pitch);
+        
+        for(idx = x1; idx < x2; ++idx) {
+            row[idx] = colour;
+        }
+    }
+}
+
+static void draw_text(SDL_Surface *screen, const SDL_Rect *clip, int x, int y, const char *text) {
+    const uint8_t   *glyph;
+    int              row;
+    int              col;
+    
+    for(; *text != '\0'; ++text, x += CELL_WIDTH) {
+        glyph = font[toupper((unsigned char)*text) & 127];
+        
+        for(row = 0; row < GLYPH_HEIGHT; ++row) {
+            for(col = 0; col < GLYPH_WIDTH; ++col) {
+                if(glyph[row] & (1 << (GLYPH_WIDTH - 1 - col))) {
+                    fill(screen, clip, x + col, y + row, 1, 1, COLOUR_HUD_TEXT);
+                }
+            }
+        }
+    }
+}
+
+/* Draw the HUD on an opaque panel with its top left corner at (x, y), within
+ * the screen, which must be locked. The area drawn is returned in rect. */
+void hud_render(hud_t *hud, SDL_Surface *screen, int x, int y, SDL_Rect *rect) {
+    SDL_Rect     clip;
+    int64_t      now;
+    int          left;
+    int          top;
+    int          width;
+    int          height;
+    int          idx;
+    
+    now = frame_clock_now();
+    
+    if(now - hud->period_start >= HUD_PERIOD) {
+        update(hud, now);
+    }
+    
+    /* computed as int, since the width and height of a SDL_Rect are unsigned */
+    left    = (x > 0) ? x : 0;
+    top     = (y > 0) ? y : 0;
+    width   = (x + HUD_WIDTH  < screen->w) ? x + HUD_WIDTH  - left : screen->w - left;
+    height  = (y + HUD_HEIGHT < screen->h) ? y + HUD_HEIGHT - top  : screen->h - top;
+    
+    clip.x = left;
+    clip.y = top;
+    clip.w = (width  > 0) ? width  : 0;
+    clip.h = (height > 0) ? height : 0;
+    
+    *rect = clip;
+    
+    fill(screen, &clip, x, y, HUD_WIDTH, HUD_HEIGHT, COLOUR_HUD_BG);
+    
+    x += PADDING;
+    y += PADDING;
+    
+    for(idx = 0; idx < HUD_LINES; ++idx) {
+        draw_text(screen, &clip, x, y + idx * CELL_HEIGHT, hud->text[idx]);
+    }
+    
+    /* utilisation of each thread, as a bar the height of a glyph */
+    x += BARS_COLUMN * CELL_WIDTH;
+    y += (HUD_LINES - 1) * CELL_HEIGHT;
+    
+    for(idx = 0; idx < hud->thread_n; ++idx) {
+        height = (int)(hud->utilisation[idx] * GLYPH_HEIGHT + 0.5f);
+        height = (height < GLYPH_HEIGHT) ? height : GLYPH_HEIGHT;
+        
+        fill(screen, &clip, x + idx * (BAR_WIDTH + 1), y, BAR_WIDTH, GLYPH_HEIGHT - height, COLOUR_HUD_BAR_BG);
+        fill(screen, &clip, x + idx * (BAR_WIDTH + 1), y + GLYPH_HEIGHT - height, BAR_WIDTH, height, COLOUR_HUD_BAR);
+    }
+}
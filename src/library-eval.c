@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Evaluate every genome of a library (see library.h) without breeding.
+ * 
+ * Each genome is simulated alone for the same scene scripts, i.e. with the
+ * same random numbers, so the fitness scores can be compared with each other
+ * and from one run to the next (for the same seed). Genomes are shared among
+ * threads, one per core. Prints the saved and evaluated fitness score of each
+ * genome, then the mean and the best.
+ * 
+ * Usage: library-eval library [scripts [seed]] */
+
+#include <sys/time.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "brain.h"
+#include "breeder.h"
+#include "critter.h"
+#include "genome.h"
+#include "library.h"
+#include "scene.h"
+#include "util.h"
+
+#ifdef _SC_NPROCESSORS_ONLN
+#define NUMBER_OF_CORES   (sysconf( _SC_NPROCESSORS_ONLN ))
+#else
+#define NUMBER_OF_CORES   0
+#endif
+
+#define DEFAULT_SCRIPTS         8
+
+#define MILLISECONDS_PER_SECOND 1000
+
+typedef struct {
+    const library_t         *library;
+    const scene_script_t    *scripts;
+    int                      scripts_n;
+    float                   *fitness;
+    int                      next;      /* next genome to evaluate, shared */
+} evaluation_t;
+
+static float evaluate(scene_t *scene, genome_t *genome, const scene_script_t *scripts, int scripts_n) {
+    critter_t   *critter;
+    float        delta;
+    float        fitness;
+    int          step;
+    int          idx;
+    
+    critter = critter_new(genome);
+    
+    if(critter == NULL) {
+        return 0.0;
+    }
+    
+    delta = (float)(BREEDER_TIME_STEP) / (float)MILLISECONDS_PER_SECOND;
+    
+    scene_add_critter(scene, critter);
+    
+    for(idx = 0; idx < scripts_n; ++idx) {
+        scene_set_script(scene, &scripts[idx]);
+        
+        for(step = 0; step < BREEDER_SIM_STEPS; ++step) {
+            scene_update(scene, delta);
+        }
+    }
+    
+    critter = scene_harvest_critter(scene);
+    
+    fitness  = BREEDER_FOOD_COST * critter->food_count + BREEDER_DANGER_COST * critter->danger_count;
+    fitness /= scripts_n;
+    
+    critter_free(critter);
+    
+    return fitness;
+}
+
+static void *evaluate_thread(void *param) {
+    evaluation_t    *evaluation;
+    genome_t        *genome;
+    scene_t         *scene;
+    int              idx;
+    
+    evaluation  = param;
+    scene       = scene_new();
+    
+    if(scene == NULL) {
+        return NULL;
+    }
+    
+    while(true) {
+        idx = __atomic_fetch_add(&evaluation->next, 1, __ATOMIC_RELAXED);
+        
+        if(idx >= library_count(evaluation->library)) {
+            break;
+        }
+        
+        genome = library_genome(evaluation->library, idx);
+        
+        if(genome != NULL) {
+            evaluation->fitness[idx] = evaluate(scene, genome, evaluation->scripts, evaluation->scripts_n);
+            genome_free(genome);
+        }
+    }
+    
+    scene_free(scene);
+    
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    evaluation_t     evaluation;
+    library_t       *library;
+    scene_script_t  *scripts;
+    pthread_t       *threads;
+    struct timeval   start;
+    struct timeval   end;
+    double           sum;
+    int              thread_n;
+    int              count;
+    int              best;
+    int              idx;
+    
+    if(argc < 2) {
+        fprintf(stderr, "Usage: %s library [scripts [seed]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    library = library_open(argv[1]);
+    
+    if(library == NULL) {
+        fprintf(stderr, "Cannot open library: %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    
+    brain_set_topology(library_topology(library));
+    
+    evaluation.scripts_n = DEFAULT_SCRIPTS;
+    
+    if(argc > 2) {
+        evaluation.scripts_n = atoi(argv[2]);
+    }
+    
+    srand(argc > 3 ? atoi(argv[3]) : 1);
+    
+    count       = library_count(library);
+    thread_n    = NUMBER_OF_CORES;
+    
+    if(thread_n < 1) {
+        thread_n = 1;
+    }
+    
+    scripts             = malloc(evaluation.scripts_n * sizeof(scene_script_t));
+    threads             = malloc(thread_n * sizeof(pthread_t));
+    evaluation.fitness  = calloc(count, sizeof(float));
+    
+    if(evaluation.scripts_n < 1 || scripts == NULL || threads == NULL || evaluation.fitness == NULL) {
+        fprintf(stderr, "Cannot start evaluation\n");
+        return EXIT_FAILURE;
+    }
+    
+    for(idx = 0; idx < evaluation.scripts_n; ++idx) {
+        scene_script_generate(&scripts[idx]);
+    }
+    
+    evaluation.library  = library;
+    evaluation.scripts  = scripts;
+    evaluation.next     = 0;
+    
+    gettimeofday(&start, NULL);
+    
+    for(idx = 0; idx < thread_n; ++idx) {
+        if(pthread_create(&threads[idx], NULL, evaluate_thread, &evaluation) != 0) {
+            /* do the work in this thread instead */
+            thread_n = idx;
+            evaluate_thread(&evaluation);
+            break;
+        }
+    }
+    
+    for(idx = 0; idx < thread_n; ++idx) {
+        pthread_join(threads[idx], NULL);
+    }
+    
+    gettimeofday(&end, NULL);
+    
+    printf("%8s %14s %14s\n", "genome", "saved", "evaluated");
+    printf("%8s %14s %14s\n", "------", "-----", "---------");
+    
+    sum  = 0.0;
+    best = 0;
+    
+    for(idx = 0; idx < count; ++idx) {
+        printf("%8d %14.3f %14.3f\n", idx, library_fitness(library, idx), evaluation.fitness[idx]);
+        
+        sum += evaluation.fitness[idx];
+        
+        if(evaluation.fitness[idx] > evaluation.fitness[best]) {
+            best = idx;
+        }
+    }
+    
+    printf("\n");
+    
+    if(count > 0) {
+        printf("mean fitness: %.3f best: %.3f (genome %d)\n", sum / count, evaluation.fitness[best], best);
+    }
+    
+    printf("%d genomes, %d scripts, %d threads, %d ms\n", count, evaluation.scripts_n, thread_n, interval_milliseconds(&start, &end));
+    
+    free(evaluation.fitness);
+    free(threads);
+    free(scripts);
+    library_close(library);
+    
+    return EXIT_SUCCESS;
+}
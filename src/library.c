@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "library.h"
+
+/* "CRLB" */
+#define LIBRARY_MAGIC       0x424c5243u
+
+#define LIBRARY_VERSION     1
+
+#define ALIGN(size)         (((size) + LIBRARY_ALIGNMENT - 1) & ~(size_t)(LIBRARY_ALIGNMENT - 1))
+
+/* All values are in the byte order of the machine. */
+typedef struct {
+    uint32_t             magic;
+    uint32_t             version;
+    uint32_t             count;
+    uint32_t             record_size;       /* bytes, multiple of LIBRARY_ALIGNMENT */
+    uint64_t             records_offset;    /* bytes, multiple of LIBRARY_ALIGNMENT */
+    genome_topology_t    topology;
+} library_header_t;
+
+/* Followed by the used chunks of the genome, then padding up to record_size */
+typedef struct {
+    uint64_t             id;
+    uint32_t             colour;
+    float                fitness;
+    float                mutation_step;
+} __attribute__ ((aligned (16))) library_record_t;
+
+struct library_t {
+    void                    *map;
+    size_t                   size;
+    const library_header_t  *header;
+    const uint8_t           *records;
+};
+
+static inline size_t record_size(const genome_topology_t *topology) {
+    return ALIGN(sizeof(library_record_t) + topology->chunks * sizeof(gene_chunk_t));
+}
+
+static inline const library_record_t *get_record(const library_t *library, int idx) {
+    return (const library_record_t *)(library->records + (size_t)idx * library->header->record_size);
+}
+
+/* Write n genomes with their current fitness scores to a new library file */
+bool library_write(const char *path, genome_t **genomes, int n) {
+    const genome_topology_t *topology;
+    library_header_t         header;
+    library_record_t        *record;
+    FILE                    *file;
+    uint8_t                 *buffer;
+    size_t                   size;
+    int                      idx;
+    bool                     status;
+    
+    topology = genome_get_topology();
+    size     = record_size(topology);
+    
+    /* one buffer for the padded header, then reused for each record */
+    buffer = memalign(LIBRARY_ALIGNMENT, ALIGN(sizeof(library_header_t)) + size);
+    
+    if(buffer == NULL) {
+        return false;
+    }
+    
+    file = fopen(path, "wb");
+    
+    if(file == NULL) {
+        free(buffer);
+        return false;
+    }
+    
+    memset(&header, 0, sizeof(header));
+    
+    header.magic            = LIBRARY_MAGIC;
+    header.version          = LIBRARY_VERSION;
+    header.count            = n;
+    header.record_size      = size;
+    header.records_offset   = ALIGN(sizeof(library_header_t));
+    header.topology         = *topology;
+    
+    memset(buffer, 0, header.records_offset);
+    memcpy(buffer, &header, sizeof(header));
+    fwrite(buffer, 1, header.records_offset, file);
+    
+    for(idx = 0; idx < n; ++idx) {
+        memset(buffer, 0, size);
+        
+        record                  = (library_record_t *)buffer;
+        record->id              = genomes[idx]->id;
+        record->colour          = genomes[idx]->colour;
+        record->fitness         = genome_fitness(genomes[idx]);
+        record->mutation_step   = genomes[idx]->mutation_step;
+        
+        memcpy(buffer + sizeof(library_record_t), genomes[idx]->chunk, topology->chunks * sizeof(gene_chunk_t));
+        fwrite(buffer, 1, size, file);
+    }
+    
+    status = !ferror(file);
+    status = (fclose(file) == 0) && status;
+    
+    free(buffer);
+    
+    return status;
+}
+
+library_t *library_open(const char *path) {
+    library_t           *library;
+    const library_header_t *header;
+    struct stat          st;
+    int                  fd;
+    
+    library = malloc(sizeof(library_t));
+    
+    if(library == NULL) {
+        return NULL;
+    }
+    
+    fd = open(path, O_RDONLY);
+    
+    if(fd < 0) {
+        free(library);
+        return NULL;
+    }
+    
+    if(fstat(fd, &st) != 0 || st.st_size < sizeof(library_header_t)) {
+        close(fd);
+        free(library);
+        return NULL;
+    }
+    
+    library->size   = st.st_size;
+    library->map    = mmap(NULL, library->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    
+    /* the mapping remains valid once the file is closed */
+    close(fd);
+    
+    if(library->map == MAP_FAILED) {
+        free(library);
+        return NULL;
+    }
+    
+    header = library->map;
+    
+    if(     header->magic != LIBRARY_MAGIC ||
+            header->version != LIBRARY_VERSION ||
+            !genome_topology_valid(&header->topology) ||
+            header->record_size != record_size(&header->topology) ||
+            header->records_offset % LIBRARY_ALIGNMENT != 0 ||
+            header->records_offset > library->size ||
+            header->records_offset + (uint64_t)header->count * header->record_size > library->size) {
+        munmap(library->map, library->size);
+        free(library);
+        return NULL;
+    }
+    
+    library->header     = header;
+    library->records    = (const uint8_t *)library->map + header->records_offset;
+    
+    return library;
+}
+
+void library_close(library_t *library) {
+    if(library != NULL) {
+        munmap(library->map, library->size);
+        free(library);
+    }
+}
+
+int library_count(const library_t *library) {
+    return library->header->count;
+}
+
+/* Topology of the genomes of the library, which must be selected (e.g. with
+ * brain_set_topology()) before genomes are taken from it. */
+const genome_topology_t *library_topology(const library_t *library) {
+    return &library->header->topology;
+}
+
+/* Fitness score of genome idx when it was saved */
+float library_fitness(const library_t *library, int idx) {
+    return get_record(library, idx)->fitness;
+}
+
+/* New genome that is a copy of genome idx of the library (the library itself
+ * cannot be modified), or NULL if the topology of the library is not the one
+ * currently selected. The copy gets a new identifier, since identifiers are
+ * only unique within a run, and does not have a fitness score record. */
+genome_t *library_genome(const library_t *library, int idx) {
+    const library_record_t  *record;
+    genome_t                *genome;
+    
+    if(!genome_topology_equal(genome_get_topology(), library_topology(library))) {
+        return NULL;
+    }
+    
+    genome = genome_new();
+    
+    if(genome == NULL) {
+        return NULL;
+    }
+    
+    record = get_record(library, idx);
+    
+    memcpy(genome->chunk, record + 1, library->header->topology.chunks * sizeof(gene_chunk_t));
+    
+    genome->colour          = record->colour;
+    genome->mutation_step   = record->mutation_step;
+    genome->hash            = genome_hash(genome);
+    
+    return genome;
+}
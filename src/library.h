@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CRITTERS_LIBRARY_H_
+#define CRITTERS_LIBRARY_H_
+
+#include <stdbool.h>
+#include "genome.h"
+
+/* Genome library: a file of saved genomes (e.g. the champions of a previous
+ * run) with their fitness scores, which is mapped in memory read-only. After
+ * a header that describes the topology, the genomes are stored in records of
+ * fixed size aligned on LIBRARY_ALIGNMENT bytes, in the order in which they
+ * were written (i.e. best first for a population saved by the breeder). */
+
+/* Alignment of the records in the file (a cache line) */
+#define LIBRARY_ALIGNMENT   64
+
+
+typedef struct library_t library_t;
+
+
+bool library_write(const char *path, genome_t **genomes, int n);
+
+library_t *library_open(const char *path);
+
+void library_close(library_t *library);
+
+int library_count(const library_t *library);
+
+const genome_topology_t *library_topology(const library_t *library);
+
+float library_fitness(const library_t *library, int idx);
+
+genome_t *library_genome(const library_t *library, int idx);
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Reconstruct a genome from a lineage file (see lineage.h) and print it.
+ * 
+ * Usage: lineage-replay file id */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "genome.h"
+#include "lineage.h"
+
+int main(int argc, char *argv[]) {
+    lineage_reader_t    *reader;
+    genome_t            *genome;
+    uint64_t             id;
+    
+    if(argc != 3) {
+        fprintf(stderr, "Usage: %s file id\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    reader = lineage_reader_new(argv[1]);
+    
+    if(reader == NULL) {
+        fprintf(stderr, "Cannot read lineage file: %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    
+    /* the brain is not computed, so there is no need for
+     * brain_set_topology() */
+    genome_set_topology(lineage_reader_topology(reader));
+    
+    id      = strtoull(argv[2], NULL, 10);
+    genome  = lineage_reader_genome(reader, id);
+    
+    if(genome == NULL) {
+        fprintf(stderr, "Genome not found: %" PRIu64 "\n", id);
+        lineage_reader_free(reader);
+        return EXIT_FAILURE;
+    }
+    
+    printf("Genome %" PRIu64 ": colour %06x, hash %08x, mutation step %.5f\n", genome->id, genome->colour, genome->hash, genome->mutation_step);
+    genome_dump(genome);
+    
+    genome_free(genome);
+    lineage_reader_free(reader);
+    
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,606 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lineage.h"
+
+/* "CRLN" */
+#define LINEAGE_MAGIC       0x4e4c5243u
+
+#define LINEAGE_VERSION     1
+
+/* Record types. Each record is a one-byte type, the size of the payload (32
+ * bits), then the payload. All values are in the byte order of the machine. */
+
+/* Identifier (64 bits), colour, mutation step, then all weights */
+#define RECORD_GENOME       1
+
+/* Identifiers of the genome, mommy and daddy (64 bits each), colour, mutation
+ * step, mask (one bit per weight, set if the weight comes from the daddy),
+ * number of weights that come from neither parent (16 bits), then the index
+ * (16 bits) and value of each of them. If that would be larger than all the
+ * weights (e.g. for blend crossover), the number is BABY_FULL and all the
+ * weights follow instead. */
+#define RECORD_BABY         2
+
+#define BABY_FULL           0xffff
+
+/* Generation number, number of genomes, then the identifier (64 bits) and
+ * fitness score of each genome of the population */
+#define RECORD_GENERATION   3
+
+/* Generation number. Followed by a genome record for each genome of the
+ * population. */
+#define RECORD_CHECKPOINT   4
+
+/* Number of slots in the hash table used by the reader to hold the genomes
+ * that can be the parents of the following records. Must be a power of two
+ * larger than the population plus the babies of one generation. */
+#define READER_TABLE_SIZE   4096
+
+#define WEIGHTS_MAX         (4 * GENOME_MAX_CHUNKS)
+
+#define MASK_SIZE(weights)  (((weights) + 7) / 8)
+
+
+struct lineage_writer_t {
+    FILE        *file;
+    uint32_t     generation;
+    uint16_t     index[WEIGHTS_MAX];
+    float        value[WEIGHTS_MAX];
+    uint8_t      mask[MASK_SIZE(WEIGHTS_MAX)];
+};
+
+struct lineage_reader_t {
+    FILE                *file;
+    long                 start;
+    genome_topology_t    topology;
+    genome_t            *table[READER_TABLE_SIZE];
+};
+
+
+static inline int weight_count(const genome_topology_t *topology) {
+    return 4 * topology->chunks;
+}
+
+static void write_header(lineage_writer_t *writer, uint8_t type, uint32_t size) {
+    fwrite(&type, sizeof(type), 1, writer->file);
+    fwrite(&size, sizeof(size), 1, writer->file);
+}
+
+lineage_writer_t *lineage_writer_new(const char *path) {
+    lineage_writer_t    *writer;
+    uint32_t             header[2];
+    
+    writer = malloc(sizeof(lineage_writer_t));
+    
+    if(writer == NULL) {
+        return NULL;
+    }
+    
+    writer->file = fopen(path, "wb");
+    
+    if(writer->file == NULL) {
+        free(writer);
+        return NULL;
+    }
+    
+    writer->generation = 0;
+    
+    header[0] = LINEAGE_MAGIC;
+    header[1] = LINEAGE_VERSION;
+    
+    fwrite(header, sizeof(header), 1, writer->file);
+    fwrite(genome_get_topology(), sizeof(genome_topology_t), 1, writer->file);
+    
+    if(ferror(writer->file)) {
+        lineage_writer_free(writer);
+        return NULL;
+    }
+    
+    return writer;
+}
+
+void lineage_writer_free(lineage_writer_t *writer) {
+    if(writer != NULL) {
+        fclose(writer->file);
+        free(writer);
+    }
+}
+
+/* Record a genome in full */
+bool lineage_write_genome(lineage_writer_t *writer, const genome_t *genome) {
+    int weights;
+    
+    weights = weight_count(genome_get_topology());
+    
+    write_header(writer, RECORD_GENOME, sizeof(uint64_t) + 2 * sizeof(uint32_t) + weights * sizeof(float));
+    
+    fwrite(&genome->id,             sizeof(uint64_t), 1, writer->file);
+    fwrite(&genome->colour,         sizeof(uint32_t), 1, writer->file);
+    fwrite(&genome->mutation_step,  sizeof(float), 1, writer->file);
+    fwrite(genome->chunk,           sizeof(float), weights, writer->file);
+    
+    return !ferror(writer->file);
+}
+
+/* Record a baby as a delta from its parents. Must be called while the parents
+ * still exist. */
+bool lineage_write_baby(lineage_writer_t *writer, const genome_t *genome, const genome_t *mommy, const genome_t *daddy) {
+    const float     *weight;
+    uint16_t         count;
+    int              weights;
+    int              idx;
+    
+    weights = weight_count(genome_get_topology());
+    
+    count = 0;
+    
+    memset(writer->mask, 0, MASK_SIZE(weights));
+    
+    /* Weights are compared bit for bit so a weight that comes from a parent
+     * is always recognized as such. */
+    for(idx = 0; idx < weights; ++idx) {
+        weight = &genome->chunk[idx / 4].f[idx % 4];
+        
+        if(memcmp(weight, &mommy->chunk[idx / 4].f[idx % 4], sizeof(float)) == 0) {
+            continue;
+        }
+        
+        if(memcmp(weight, &daddy->chunk[idx / 4].f[idx % 4], sizeof(float)) == 0) {
+            writer->mask[idx / 8] |= 1 << (idx % 8);
+        }
+        else {
+            writer->index[count] = idx;
+            writer->value[count] = *weight;
+            ++count;
+        }
+    }
+    
+    if(count * (sizeof(uint16_t) + sizeof(float)) > weights * sizeof(float)) {
+        count = BABY_FULL;
+    }
+    
+    write_header(writer, RECORD_BABY,
+            3 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + MASK_SIZE(weights) + sizeof(uint16_t) +
+            (count == BABY_FULL ? weights * sizeof(float) : count * (sizeof(uint16_t) + sizeof(float))));
+    
+    fwrite(&genome->id,             sizeof(uint64_t), 1, writer->file);
+    fwrite(&mommy->id,              sizeof(uint64_t), 1, writer->file);
+    fwrite(&daddy->id,              sizeof(uint64_t), 1, writer->file);
+    fwrite(&genome->colour,         sizeof(uint32_t), 1, writer->file);
+    fwrite(&genome->mutation_step,  sizeof(float), 1, writer->file);
+    fwrite(writer->mask,            1, MASK_SIZE(weights), writer->file);
+    fwrite(&count,                  sizeof(uint16_t), 1, writer->file);
+    
+    if(count == BABY_FULL) {
+        fwrite(genome->chunk, sizeof(float), weights, writer->file);
+        return !ferror(writer->file);
+    }
+    
+    for(idx = 0; idx < count; ++idx) {
+        fwrite(&writer->index[idx], sizeof(uint16_t), 1, writer->file);
+        fwrite(&writer->value[idx], sizeof(float), 1, writer->file);
+    }
+    
+    return !ferror(writer->file);
+}
+
+/* Record the population at the end of a generation, and a checkpoint every
+ * LINEAGE_CHECKPOINT_INTERVAL generations. All genomes of the population must
+ * have been recorded before. */
+bool lineage_write_generation(lineage_writer_t *writer, genome_t **population, int n) {
+    uint32_t    count;
+    float       fitness;
+    int         idx, idy;
+    
+    count = n;
+    
+    write_header(writer, RECORD_GENERATION, 2 * sizeof(uint32_t) + n * (sizeof(uint64_t) + sizeof(float)));
+    
+    fwrite(&writer->generation, sizeof(uint32_t), 1, writer->file);
+    fwrite(&count,              sizeof(uint32_t), 1, writer->file);
+    
+    for(idx = 0; idx < n; ++idx) {
+        fitness = genome_fitness(population[idx]);
+        
+        fwrite(&population[idx]->id,    sizeof(uint64_t), 1, writer->file);
+        fwrite(&fitness,                sizeof(float), 1, writer->file);
+    }
+    
+    if(writer->generation % LINEAGE_CHECKPOINT_INTERVAL == 0) {
+        write_header(writer, RECORD_CHECKPOINT, sizeof(uint32_t));
+        fwrite(&writer->generation, sizeof(uint32_t), 1, writer->file);
+        
+        for(idx = 0; idx < n; ++idx) {
+            /* the same genome can appear more than once in a population */
+            for(idy = 0; idy < idx; ++idy) {
+                if(population[idy] == population[idx]) {
+                    break;
+                }
+            }
+            
+            if(idy == idx) {
+                lineage_write_genome(writer, population[idx]);
+            }
+        }
+    }
+    
+    ++writer->generation;
+    
+    /* flush at each generation so the file can be read while the breeder
+     * is running */
+    fflush(writer->file);
+    
+    return !ferror(writer->file);
+}
+
+lineage_reader_t *lineage_reader_new(const char *path) {
+    lineage_reader_t    *reader;
+    uint32_t             header[2];
+    int                  idx;
+    
+    reader = malloc(sizeof(lineage_reader_t));
+    
+    if(reader == NULL) {
+        return NULL;
+    }
+    
+    for(idx = 0; idx < READER_TABLE_SIZE; ++idx) {
+        reader->table[idx] = NULL;
+    }
+    
+    reader->file = fopen(path, "rb");
+    
+    if(reader->file == NULL) {
+        free(reader);
+        return NULL;
+    }
+    
+    if(fread(header, sizeof(header), 1, reader->file) != 1 || header[0] != LINEAGE_MAGIC || header[1] != LINEAGE_VERSION) {
+        lineage_reader_free(reader);
+        return NULL;
+    }
+    
+    if(     fread(&reader->topology, sizeof(genome_topology_t), 1, reader->file) != 1 ||
+            !genome_topology_valid(&reader->topology)) {
+        lineage_reader_free(reader);
+        return NULL;
+    }
+    
+    reader->start = ftell(reader->file);
+    
+    return reader;
+}
+
+static void table_clear(lineage_reader_t *reader) {
+    int idx;
+    
+    for(idx = 0; idx < READER_TABLE_SIZE; ++idx) {
+        genome_free(reader->table[idx]);
+        reader->table[idx] = NULL;
+    }
+}
+
+void lineage_reader_free(lineage_reader_t *reader) {
+    if(reader != NULL) {
+        table_clear(reader);
+        fclose(reader->file);
+        free(reader);
+    }
+}
+
+/* Topology of the genomes of the file, which must be selected (e.g. with
+ * brain_set_topology()) before genomes are read. */
+const genome_topology_t *lineage_reader_topology(const lineage_reader_t *reader) {
+    return &reader->topology;
+}
+
+static inline int table_slot(lineage_reader_t *reader, uint64_t id) {
+    int idx;
+    int count;
+    
+    idx = id % READER_TABLE_SIZE;
+    
+    for(count = 0; count < READER_TABLE_SIZE; ++count) {
+        if(reader->table[idx] == NULL || reader->table[idx]->id == id) {
+            return idx;
+        }
+        
+        idx = (idx + 1) % READER_TABLE_SIZE;
+    }
+    
+    return -1;
+}
+
+static genome_t *table_lookup(lineage_reader_t *reader, uint64_t id) {
+    int idx = table_slot(reader, id);
+    
+    if(idx < 0) {
+        return NULL;
+    }
+    
+    return reader->table[idx];
+}
+
+/* Takes the reference to the genome */
+static bool table_add(lineage_reader_t *reader, genome_t *genome) {
+    int idx = table_slot(reader, genome->id);
+    
+    if(idx < 0) {
+        genome_free(genome);
+        return false;
+    }
+    
+    if(reader->table[idx] != NULL) {
+        /* already known, e.g. a checkpoint of a genome that was recorded
+         * before */
+        genome_free(genome);
+        return true;
+    }
+    
+    reader->table[idx] = genome;
+    return true;
+}
+
+static genome_t *read_genome(lineage_reader_t *reader) {
+    genome_t    *genome;
+    int          weights;
+    
+    weights = weight_count(&reader->topology);
+    genome  = genome_new();
+    
+    if(genome == NULL) {
+        return NULL;
+    }
+    
+    if(     fread(&genome->id,              sizeof(uint64_t), 1, reader->file) != 1 ||
+            fread(&genome->colour,          sizeof(uint32_t), 1, reader->file) != 1 ||
+            fread(&genome->mutation_step,   sizeof(float), 1, reader->file) != 1 ||
+            fread(genome->chunk,            sizeof(float), weights, reader->file) != weights) {
+        genome_free(genome);
+        return NULL;
+    }
+    
+    genome->hash = genome_hash(genome);
+    
+    return genome;
+}
+
+static genome_t *read_baby(lineage_reader_t *reader) {
+    genome_t        *genome;
+    const genome_t  *mommy;
+    const genome_t  *daddy;
+    uint64_t         ids[2];
+    uint8_t          mask[MASK_SIZE(WEIGHTS_MAX)];
+    uint16_t         count;
+    uint16_t         index;
+    float            value;
+    int              weights;
+    int              idx;
+    
+    weights = weight_count(&reader->topology);
+    genome  = genome_new();
+    
+    if(genome == NULL) {
+        return NULL;
+    }
+    
+    if(     fread(&genome->id,              sizeof(uint64_t), 1, reader->file) != 1 ||
+            fread(ids,                      sizeof(uint64_t), 2, reader->file) != 2 ||
+            fread(&genome->colour,          sizeof(uint32_t), 1, reader->file) != 1 ||
+            fread(&genome->mutation_step,   sizeof(float), 1, reader->file) != 1 ||
+            fread(mask,                     1, MASK_SIZE(weights), reader->file) != MASK_SIZE(weights) ||
+            fread(&count,                   sizeof(uint16_t), 1, reader->file) != 1) {
+        genome_free(genome);
+        return NULL;
+    }
+    
+    mommy = table_lookup(reader, ids[0]);
+    daddy = table_lookup(reader, ids[1]);
+    
+    if(mommy == NULL || daddy == NULL) {
+        genome_free(genome);
+        return NULL;
+    }
+    
+    for(idx = 0; idx < weights; ++idx) {
+        if(mask[idx / 8] & (1 << (idx % 8))) {
+            genome->chunk[idx / 4].f[idx % 4] = daddy->chunk[idx / 4].f[idx % 4];
+        }
+        else {
+            genome->chunk[idx / 4].f[idx % 4] = mommy->chunk[idx / 4].f[idx % 4];
+        }
+    }
+    
+    if(count == BABY_FULL) {
+        if(fread(genome->chunk, sizeof(float), weights, reader->file) != weights) {
+            genome_free(genome);
+            return NULL;
+        }
+        
+        count = 0;
+    }
+    
+    while(count-- > 0) {
+        if(     fread(&index, sizeof(uint16_t), 1, reader->file) != 1 ||
+                fread(&value, sizeof(float), 1, reader->file) != 1 ||
+                index >= weights) {
+            genome_free(genome);
+            return NULL;
+        }
+        
+        genome->chunk[index / 4].f[index % 4] = value;
+    }
+    
+    genome->hash = genome_hash(genome);
+    
+    return genome;
+}
+
+/* Only keep the genomes of the population, i.e. those that can be parents
+ * from now on. */
+static bool read_generation(lineage_reader_t *reader) {
+    genome_t   **population;
+    uint32_t     header[2];
+    uint64_t     id;
+    float        fitness;
+    uint32_t     idx;
+    bool         status;
+    
+    if(fread(header, sizeof(header), 1, reader->file) != 1) {
+        return false;
+    }
+    
+    population = malloc(header[1] * sizeof(genome_t *));
+    
+    if(population == NULL) {
+        return false;
+    }
+    
+    for(idx = 0; idx < header[1]; ++idx) {
+        if(fread(&id, sizeof(uint64_t), 1, reader->file) != 1 || fread(&fitness, sizeof(float), 1, reader->file) != 1) {
+            header[1] = idx;
+            break;
+        }
+        
+        population[idx] = table_lookup(reader, id);
+        
+        if(population[idx] != NULL) {
+            genome_clone(population[idx]);
+        }
+    }
+    
+    table_clear(reader);
+    
+    status = true;
+    
+    for(idx = 0; idx < header[1]; ++idx) {
+        if(population[idx] != NULL) {
+            status = table_add(reader, population[idx]) && status;
+        }
+    }
+    
+    free(population);
+    
+    return status;
+}
+
+/* Reconstruct the genome with this identifier. First, find its record and
+ * the last checkpoint before it, then replay the file from that checkpoint
+ * up to that record. Returns NULL if the genome cannot be found or the
+ * topology of the file is not the one currently selected. */
+genome_t *lineage_reader_genome(lineage_reader_t *reader, uint64_t id) {
+    genome_t    *genome;
+    uint64_t     record_id;
+    uint32_t     size;
+    uint8_t      type;
+    long         offset;
+    long         checkpoint;
+    long         target;
+    
+    if(genome_get_topology()->chunks != reader->topology.chunks) {
+        return NULL;
+    }
+    
+    /* find the record of the genome and the last checkpoint before it */
+    checkpoint  = reader->start;
+    target      = -1;
+    
+    fseek(reader->file, reader->start, SEEK_SET);
+    
+    while(target < 0) {
+        offset = ftell(reader->file);
+        
+        if(fread(&type, sizeof(type), 1, reader->file) != 1 || fread(&size, sizeof(size), 1, reader->file) != 1) {
+            return NULL;
+        }
+        
+        if(type == RECORD_CHECKPOINT) {
+            checkpoint = offset;
+        }
+        else if(type == RECORD_GENOME || type == RECORD_BABY) {
+            if(fread(&record_id, sizeof(uint64_t), 1, reader->file) != 1) {
+                return NULL;
+            }
+            
+            if(record_id == id) {
+                target = offset;
+            }
+            
+            size -= sizeof(uint64_t);
+        }
+        
+        fseek(reader->file, size, SEEK_CUR);
+    }
+    
+    /* replay */
+    table_clear(reader);
+    fseek(reader->file, checkpoint, SEEK_SET);
+    
+    while(true) {
+        offset = ftell(reader->file);
+        
+        if(fread(&type, sizeof(type), 1, reader->file) != 1 || fread(&size, sizeof(size), 1, reader->file) != 1) {
+            return NULL;
+        }
+        
+        switch(type) {
+        case RECORD_GENOME:
+            genome = read_genome(reader);
+            break;
+        case RECORD_BABY:
+            genome = read_baby(reader);
+            break;
+        case RECORD_GENERATION:
+            if(!read_generation(reader)) {
+                return NULL;
+            }
+            continue;
+        default:
+            fseek(reader->file, size, SEEK_CUR);
+            continue;
+        }
+        
+        if(genome == NULL) {
+            return NULL;
+        }
+        
+        if(offset == target) {
+            break;
+        }
+        
+        if(!table_add(reader, genome)) {
+            return NULL;
+        }
+    }
+    
+    return genome;
+}
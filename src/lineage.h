@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CRITTERS_LINEAGE_H_
+#define CRITTERS_LINEAGE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "genome.h"
+
+/* Lineage file: an append-only record of every genome created by the breeder.
+ * Novel (i.e. randomly-generated) genomes are recorded in full. Babies are
+ * recorded as a delta from their parents: the identifiers of the parents, a
+ * mask that tells for each weight which parent it comes from, then the index
+ * and value of the weights that come from neither (mutations, or all of them
+ * for blend crossover). At the end of each generation, the identifiers and
+ * fitness scores of the genomes of the population are recorded and, every
+ * LINEAGE_CHECKPOINT_INTERVAL generations, the whole population is recorded
+ * in full as a checkpoint from which genomes can be reconstructed without
+ * going back to the start of the file. */
+
+/* Number of generations between checkpoints */
+#define LINEAGE_CHECKPOINT_INTERVAL     100
+
+
+typedef struct lineage_writer_t lineage_writer_t;
+
+typedef struct lineage_reader_t lineage_reader_t;
+
+
+lineage_writer_t *lineage_writer_new(const char *path);
+
+void lineage_writer_free(lineage_writer_t *writer);
+
+bool lineage_write_genome(lineage_writer_t *writer, const genome_t *genome);
+
+bool lineage_write_baby(lineage_writer_t *writer, const genome_t *genome, const genome_t *mommy, const genome_t *daddy);
+
+bool lineage_write_generation(lineage_writer_t *writer, genome_t **population, int n);
+
+
+lineage_reader_t *lineage_reader_new(const char *path);
+
+void lineage_reader_free(lineage_reader_t *reader);
+
+const genome_topology_t *lineage_reader_topology(const lineage_reader_t *reader);
+
+genome_t *lineage_reader_genome(lineage_reader_t *reader, uint64_t id);
+
+#endif
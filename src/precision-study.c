@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Accuracy vs speed study of the reduced precision simulation.
+ * 
+ * A population is first evolved with the regular floating-point simulation.
+ * Then, the brain of every genome of that population is computed with each
+ * reduced precision (SCENE_PRECISION_FIXED and SCENE_PRECISION_INT8) for
+ * random stimuli and the controls are compared with the floating-point ones.
+ * Finally, every genome is simulated once with each precision following the
+ * same scene scripts, i.e. with the same random numbers, and the resulting
+ * fitness scores and rankings are compared. For reference, the floating-point
+ * results are also compared with those of a floating-point simulation that
+ * follows a different set of scripts.
+ * 
+ * Usage: precision-study [generations [seed]] */
+
+#include <quatre/macros.h>
+#include <sys/time.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "breeder.h"
+#include "critter.h"
+#include "genome.h"
+#include "scene.h"
+#include "util.h"
+
+#ifdef _SC_NPROCESSORS_ONLN
+#define NUMBER_OF_CORES   (sysconf( _SC_NPROCESSORS_ONLN ))
+#else
+#define NUMBER_OF_CORES   0
+#endif
+
+#define DEFAULT_GENERATIONS     200
+
+#define STUDY_SCRIPTS           8
+
+#define MILLISECONDS_PER_SECOND 1000
+
+/* Number of random stimuli for which the controls are compared, per genome */
+#define CONTROL_SAMPLES         1000
+
+typedef struct {
+    const float *fitness;
+    int          index;
+} rank_entry_t;
+
+/* Simulation runs: the last one uses floating point with a different set of
+ * scripts and serves as a reference for the noise inherent to the fitness
+ * score. */
+#define RUNS                    4
+
+#define RUN_REFERENCE           3
+
+/* The runs before the reference one each use a different precision */
+#define PRECISIONS              RUN_REFERENCE
+
+static const char *run_names[RUNS] = {"float", "fixed", "int8", "float (other scripts)"};
+
+static const int run_precisions[RUNS] = {SCENE_PRECISION_FLOAT, SCENE_PRECISION_FIXED, SCENE_PRECISION_INT8, SCENE_PRECISION_FLOAT};
+
+static inline float random_unit(void) {
+    return (float)rand() / (float)RAND_MAX;
+}
+
+/* Compute the brain of each genome with each precision for the same random
+ * stimuli and print how far the controls are from the floating-point ones. */
+static void compare_controls(genome_t **genomes, int n) {
+    brain_control_t  control[PRECISIONS];
+    stimuli_t        stimuli;
+    critter_t       *critter;
+    double           diff[PRECISIONS];
+    double           max[PRECISIONS];
+    double           delta;
+    int              precision;
+    int              sample;
+    int              idx;
+    
+    for(precision = 1; precision < PRECISIONS; ++precision) {
+        diff[precision] = 0.0;
+        max[precision]  = 0.0;
+    }
+    
+    for(idx = 0; idx < n; ++idx) {
+        critter = critter_new(genomes[idx]);
+        
+        if(critter == NULL) {
+            continue;
+        }
+        
+        for(sample = 0; sample < CONTROL_SAMPLES; ++sample) {
+            stimuli.food_intensity      = random_unit();
+            stimuli.food_angle          = 2.0 * random_unit() - 1.0;
+            stimuli.danger_intensity    = random_unit();
+            stimuli.danger_angle        = 2.0 * random_unit() - 1.0;
+            stimuli.wall_intensity      = random_unit();
+            stimuli.wall_angle          = 2.0 * random_unit() - 1.0;
+            stimuli.food_odour          = random_unit();
+            stimuli.danger_odour        = random_unit();
+            
+            critter_update_brain(critter, &stimuli);
+            control[0] = critter->brain_control;
+            
+            critter_update_brain_fixed(critter, &stimuli);
+            control[1] = critter->brain_control;
+            
+            critter_update_brain_int8(critter, &stimuli);
+            control[2] = critter->brain_control;
+            
+            for(precision = 1; precision < PRECISIONS; ++precision) {
+                delta = fabs(control[precision].left_speed - control[0].left_speed);
+                delta = fmax(delta, fabs(control[precision].right_speed - control[0].right_speed));
+                
+                diff[precision] += delta;
+                max[precision]   = fmax(max[precision], delta);
+            }
+        }
+        
+        critter_free(critter);
+    }
+    
+    printf("controls: %d random stimuli per genome\n\n", CONTROL_SAMPLES);
+    printf("%-24s mean abs. difference   max abs. difference\n", "float vs");
+    printf("%-24s -------------------   ------------------\n", "--------");
+    
+    for(precision = 1; precision < PRECISIONS; ++precision) {
+        printf("%-24s %19.6f   %18.6f\n",
+                run_names[precision],
+                diff[precision] / ((double)n * CONTROL_SAMPLES),
+                max[precision]);
+    }
+    
+    printf("\n");
+}
+
+static float evaluate(scene_t *scene, genome_t *genome, const scene_script_t *scripts, int precision) {
+    critter_t   *critter;
+    float        delta;
+    float        fitness;
+    int          step;
+    int          idx;
+    
+    critter = critter_new(genome);
+    
+    if(critter == NULL) {
+        return 0.0;
+    }
+    
+    delta = (float)(BREEDER_TIME_STEP) / (float)MILLISECONDS_PER_SECOND;
+    
+    scene_set_precision(scene, precision);
+    scene_add_critter(scene, critter);
+    
+    for(idx = 0; idx < STUDY_SCRIPTS; ++idx) {
+        scene_set_script(scene, &scripts[idx]);
+        
+        for(step = 0; step < BREEDER_SIM_STEPS; ++step) {
+            scene_update(scene, delta);
+        }
+    }
+    
+    critter = scene_harvest_critter(scene);
+    
+    fitness  = BREEDER_FOOD_COST * critter->food_count + BREEDER_DANGER_COST * critter->danger_count;
+    fitness *= 1.0 / STUDY_SCRIPTS;
+    
+    critter_free(critter);
+    
+    return fitness;
+}
+
+static int compare_rank_entries(const void *a, const void *b) {
+    const rank_entry_t *entry_a = a;
+    const rank_entry_t *entry_b = b;
+    float               fitness_a;
+    float               fitness_b;
+    
+    fitness_a = entry_a->fitness[entry_a->index];
+    fitness_b = entry_b->fitness[entry_b->index];
+    
+    /* best first */
+    if(fitness_a > fitness_b) {
+        return -1;
+    }
+    
+    if(fitness_a < fitness_b) {
+        return 1;
+    }
+    
+    return 0;
+}
+
+/* Rank 0 is the best. Tied genomes all get the average of their ranks. */
+static void compute_ranks(float *rank, const float *fitness, int n) {
+    rank_entry_t    *entries;
+    int              idx, idy;
+    float            average;
+    
+    entries = malloc(n * sizeof(rank_entry_t));
+    
+    if(entries == NULL) {
+        return;
+    }
+    
+    for(idx = 0; idx < n; ++idx) {
+        entries[idx].fitness    = fitness;
+        entries[idx].index      = idx;
+    }
+    
+    qsort(entries, n, sizeof(rank_entry_t), compare_rank_entries);
+    
+    idx = 0;
+    
+    while(idx < n) {
+        idy = idx;
+        
+        while(idy + 1 < n && fitness[entries[idy + 1].index] == fitness[entries[idx].index]) {
+            ++idy;
+        }
+        
+        average = 0.5 * (float)(idx + idy);
+        
+        for(; idx <= idy; ++idx) {
+            rank[entries[idx].index] = average;
+        }
+    }
+    
+    free(entries);
+}
+
+static void compare(const float *fitness[2], const float *rank[2], int n, const char *name) {
+    char    label[64];
+    int     top_both;
+    int     kept_both;
+    int     idx;
+    double  d2;
+    double  diff;
+    double  rho;
+    
+    d2          = 0.0;
+    diff        = 0.0;
+    top_both    = 0;
+    kept_both   = 0;
+    
+    for(idx = 0; idx < n; ++idx) {
+        d2   += (rank[0][idx] - rank[1][idx]) * (rank[0][idx] - rank[1][idx]);
+        diff += fabs(fitness[0][idx] - fitness[1][idx]);
+        
+        if(rank[0][idx] < BREEDER_BEST_KEEP && rank[1][idx] < BREEDER_BEST_KEEP) {
+            ++top_both;
+        }
+        
+        if(rank[0][idx] < n - BREEDER_WORST_DISCARD && rank[1][idx] < n - BREEDER_WORST_DISCARD) {
+            ++kept_both;
+        }
+    }
+    
+    /* Spearman's rank correlation coefficient */
+    rho = 1.0 - 6.0 * d2 / ((double)n * ((double)n * n - 1.0));
+    
+    printf("\n");
+    printf("float vs %s:\n", name);
+    printf("    %-40s %8.3f\n", "mean absolute fitness difference:", diff / (double)n);
+    printf("    %-40s %8.3f\n", "rank correlation (Spearman):", rho);
+    
+    sprintf(label, "top %d in both:", BREEDER_BEST_KEEP);
+    printf("    %-40s %8d\n", label, top_both);
+    
+    sprintf(label, "not discarded in both (out of %d):", n - BREEDER_WORST_DISCARD);
+    printf("    %-40s %8d\n", label, kept_both);
+}
+
+int main(int argc, char *argv[]) {
+    breeder_t           *breeder;
+    breeder_iterator_t  *iter;
+    genome_t            *genome;
+    genome_t           **genomes;
+    scene_t             *scene;
+    scene_script_t       scripts[2][STUDY_SCRIPTS];
+    float               *fitness[RUNS];
+    float               *rank[RUNS];
+    const float         *pair_fitness[2];
+    const float         *pair_rank[2];
+    struct timeval       start;
+    struct timeval       end;
+    int                  duration[RUNS];
+    int                  generations;
+    int                  run;
+    int                  seed;
+    int                  n;
+    int                  idx;
+    
+    generations = DEFAULT_GENERATIONS;
+    seed        = 1;
+    
+    if(argc > 1) {
+        generations = atoi(argv[1]);
+    }
+    
+    if(argc > 2) {
+        seed = atoi(argv[2]);
+    }
+    
+    srand(seed);
+    
+    /* evolve a population */
+    breeder = breeder_new(NUMBER_OF_CORES);
+    scene   = scene_new();
+    genomes = malloc(BREEDER_POPULATION_SIZE * sizeof(genome_t *));
+    
+    for(run = 0; run < RUNS; ++run) {
+        fitness[run]    = malloc(BREEDER_POPULATION_SIZE * sizeof(float));
+        rank[run]       = malloc(BREEDER_POPULATION_SIZE * sizeof(float));
+        
+        if(fitness[run] == NULL || rank[run] == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+    
+    if(breeder == NULL || scene == NULL || genomes == NULL) {
+        fprintf(stderr, "Cannot create breeder or scene\n");
+        return EXIT_FAILURE;
+    }
+    
+    printf("evolving %d generations with seed %d\n", generations, seed);
+    
+    for(idx = 0; idx < generations; ++idx) {
+        breeder_next_generation(breeder);
+    }
+    
+    iter = breeder_iterator_new(breeder);
+    
+    if(iter == NULL) {
+        fprintf(stderr, "Cannot iterate over population\n");
+        return EXIT_FAILURE;
+    }
+    
+    genome  = breeder_iterator_current(iter);
+    n       = 0;
+    
+    while(genome != NULL && n < BREEDER_POPULATION_SIZE) {
+        genomes[n++] = genome_clone(genome);
+        genome = breeder_iterator_next(iter);
+    }
+    
+    breeder_iterator_free(iter);
+    
+    compare_controls(genomes, n);
+    
+    /* simulate every genome for each run */
+    for(idx = 0; idx < STUDY_SCRIPTS; ++idx) {
+        scene_script_generate(&scripts[0][idx]);
+        scene_script_generate(&scripts[1][idx]);
+    }
+    
+    for(run = 0; run < RUNS; ++run) {
+        gettimeofday(&start, NULL);
+        
+        for(idx = 0; idx < n; ++idx) {
+            fitness[run][idx] = evaluate(scene, genomes[idx], scripts[run == RUN_REFERENCE], run_precisions[run]);
+        }
+        
+        gettimeofday(&end, NULL);
+        duration[run] = interval_milliseconds(&start, &end);
+        
+        compute_ranks(rank[run], fitness[run], n);
+    }
+    
+    printf("genomes: %d scripts: %d\n\n", n, STUDY_SCRIPTS);
+    printf("%-24s duration (ms)   speed-up\n", "run");
+    printf("%-24s -------------   --------\n", "---");
+    
+    for(run = 0; run < RUNS; ++run) {
+        printf("%-24s %13d   %8.2f\n",
+                run_names[run],
+                duration[run],
+                (double)duration[0] / (double)qrt_max(duration[run], 1));
+    }
+    
+    pair_fitness[0] = fitness[0];
+    pair_rank[0]    = rank[0];
+    
+    for(run = 1; run < RUNS; ++run) {
+        pair_fitness[1] = fitness[run];
+        pair_rank[1]    = rank[run];
+        
+        compare(pair_fitness, pair_rank, n, run_names[run]);
+    }
+    
+    for(idx = 0; idx < n; ++idx) {
+        genome_free(genomes[idx]);
+    }
+    
+    for(run = 0; run < RUNS; ++run) {
+        free(fitness[run]);
+        free(rank[run]);
+    }
+    
+    free(genomes);
+    scene_free(scene);
+    breeder_free(breeder);
+    
+    return EXIT_SUCCESS;
+}
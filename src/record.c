@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Record a video of champions without a window, e.g. on a server.
+ * 
+ * Five critters, the champions of a library (see library.h) or random ones,
+ * are simulated with the same time step as during training and rendered
+ * offscreen at RECORD_FRAME_RATE, with positions interpolated between time
+ * steps as in the GUI. Frames are written by an encoder thread (see
+ * recorder.h): a YUV4MPEG2 stream to a file, to the standard output ("-") or
+ * to a command ("|command"), or a sequence of PNG images if the output ends
+ * with ".png" (a printf() format for the frame number, e.g. "f%05d.png").
+ * 
+ * Usage: record [-g library] output [seconds] */
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "brain.h"
+#include "breeder.h"
+#include "critter.h"
+#include "genome.h"
+#include "library.h"
+#include "recorder.h"
+#include "scene.h"
+#include "sprite.h"
+#include "util.h"
+
+#define RECORD_FRAME_RATE       25
+
+#define RECORD_CRITTERS         5
+
+#define DEFAULT_SECONDS         20
+
+/* Things are drawn up to their bound beyond the edges of the scene */
+#define MARGIN                  SPRITE_MAX_BOUND
+
+#define COLOUR_BG               rgb(0, 0, 0)
+
+#define COLOUR_SCENE_BG         rgb(30, 30, 30)
+
+#define MILLISECONDS_PER_SECOND 1000
+
+#define FRAMES_PER_STEP         (RECORD_FRAME_RATE * BREEDER_TIME_STEP / MILLISECONDS_PER_SECOND)
+
+#define USAGE                   "Usage: %s [-g library] output [seconds]\n"
+
+
+int main(int argc, char *argv[]) {
+    scene_snapshot_t    *before;
+    scene_snapshot_t    *after;
+    scene_snapshot_t    *frame;
+    scene_snapshot_t    *snapshot;
+    SDL_Surface         *surface;
+    SDL_Rect             scene_rect;
+    recorder_t          *recorder;
+    library_t           *library;
+    critter_t           *critter;
+    genome_t            *genome;
+    scene_t             *scene;
+    float                delta;
+    int                  seconds;
+    int                  steps;
+    int                  step;
+    int                  idx;
+    
+    library = NULL;
+    
+    if(argc > 2 && strcmp(argv[1], "-g") == 0) {
+        library = library_open(argv[2]);
+        
+        if(library == NULL) {
+            fprintf(stderr, "Cannot open library: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        
+        brain_set_topology(library_topology(library));
+        
+        argv[2] = argv[0];
+        argv   += 2;
+        argc   -= 2;
+    }
+    
+    if(argc < 2) {
+        fprintf(stderr, USAGE, argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    seconds = (argc > 2) ? atoi(argv[2]) : DEFAULT_SECONDS;
+    
+    srand(time(NULL));
+    
+    scene = scene_new();
+    
+    if(scene == NULL) {
+        fprintf(stderr, "Cannot create scene\n");
+        return EXIT_FAILURE;
+    }
+    
+    for(idx = 0; idx < RECORD_CRITTERS; ++idx) {
+        if(library != NULL && idx < library_count(library)) {
+            genome = library_genome(library, idx);
+        }
+        else {
+            genome = genome_new();
+            
+            if(genome != NULL) {
+                genome_make_random(genome);
+            }
+        }
+        
+        if(genome != NULL) {
+            critter = critter_new(genome);
+            
+            if(critter != NULL) {
+                scene_add_critter(scene, critter);
+            }
+            
+            genome_free(genome);
+        }
+    }
+    
+    if(library != NULL) {
+        library_close(library);
+    }
+    
+    scene_rect.x = MARGIN;
+    scene_rect.y = MARGIN;
+    scene_rect.w = SCENE_WIDTH;
+    scene_rect.h = SCENE_HEIGHT;
+    
+    /* in memory, without initializing the SDL video subsystem */
+    surface     = SDL_CreateRGBSurface(SDL_SWSURFACE, SCENE_WIDTH + 2 * MARGIN, SCENE_HEIGHT + 2 * MARGIN, 32, 0xff0000, 0xff00, 0xff, 0);
+    recorder    = recorder_new(argv[1], SCENE_WIDTH + 2 * MARGIN, SCENE_HEIGHT + 2 * MARGIN, RECORD_FRAME_RATE);
+    before      = scene_snapshot_new();
+    after       = scene_snapshot_new();
+    frame       = scene_snapshot_new();
+    
+    if(surface == NULL || recorder == NULL || before == NULL || after == NULL || frame == NULL) {
+        fprintf(stderr, "Cannot start recording to %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    
+    delta   = (float)(BREEDER_TIME_STEP) / (float)MILLISECONDS_PER_SECOND;
+    steps   = seconds * MILLISECONDS_PER_SECOND / BREEDER_TIME_STEP;
+    
+    scene_snapshot_take(after, scene);
+    
+    for(step = 0; step < steps; ++step) {
+        snapshot    = before;
+        before      = after;
+        after       = snapshot;
+        
+        scene_update(scene, delta);
+        scene_snapshot_take(after, scene);
+        
+        for(idx = 0; idx < FRAMES_PER_STEP; ++idx) {
+            scene_snapshot_interpolate(frame, before, after, (float)(idx + 1) / (float)FRAMES_PER_STEP);
+            
+            SDL_FillRect(surface, NULL, COLOUR_BG);
+            SDL_FillRect(surface, &scene_rect, COLOUR_SCENE_BG);
+            scene_snapshot_render(frame, surface, MARGIN, MARGIN);
+            
+            /* don't drop frames, wait for the encoder if it is behind */
+            recorder_sync(recorder);
+            recorder_submit(recorder, surface);
+        }
+    }
+    
+    recorder_free(recorder);
+    scene_snapshot_free(before);
+    scene_snapshot_free(after);
+    scene_snapshot_free(frame);
+    SDL_FreeSurface(surface);
+    scene_free(scene);
+    
+    fprintf(stderr, "%d frames\n", steps * FRAMES_PER_STEP);
+    
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,531 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for popen() and strdup() */
+#include <quatre/macros.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "recorder.h"
+
+/* Largest block of a deflate stream that is stored without compression */
+#define PNG_STORED_BLOCK    65535
+
+/* Frames are written by an encoder thread. There are two frame buffers: the
+ * one the encoder is writing out and the one filled by recorder_submit(),
+ * which is then pending until the encoder takes it. A frame submitted while
+ * the previous one is still pending is dropped, so submitting never waits for
+ * the encoder. */
+struct recorder_t {
+    FILE            *file;
+    char            *pattern;
+    uint32_t        *filling;
+    uint32_t        *encoding;
+    uint8_t         *buffer;
+    size_t           buffer_size;
+    pthread_t        thread;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;
+    int              format;
+    int              width;
+    int              height;
+    int              frames;
+    int              dropped;
+    bool             pipe;
+    bool             pending;
+    bool             stop;
+    bool             error;
+};
+
+static uint32_t crc_table[256];
+
+static void crc_table_init(void) {
+    uint32_t    crc;
+    int         idx, bit;
+    
+    for(idx = 0; idx < 256; ++idx) {
+        crc = idx;
+        
+        for(bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+        }
+        
+        crc_table[idx] = crc;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *data, size_t size) {
+    size_t idx;
+    
+    for(idx = 0; idx < size; ++idx) {
+        crc = crc_table[(crc ^ data[idx]) & 0xff] ^ (crc >> 8);
+    }
+    
+    return crc;
+}
+
+static uint8_t *put_uint32(uint8_t *dest, uint32_t value) {
+    dest[0] = value >> 24;
+    dest[1] = value >> 16;
+    dest[2] = value >> 8;
+    dest[3] = value;
+    
+    return dest + 4;
+}
+
+static void png_chunk(FILE *file, const char *type, const uint8_t *data, size_t size) {
+    uint8_t     bytes[4];
+    uint32_t    crc;
+    
+    put_uint32(bytes, size);
+    fwrite(bytes, 4, 1, file);
+    fwrite(type, 4, 1, file);
+    
+    crc = crc_update(0xffffffff, (const uint8_t *)type, 4);
+    
+    /* data is NULL for an empty chunk, e.g. IEND */
+    if(size > 0) {
+        fwrite(data, size, 1, file);
+        crc = crc_update(crc, data, size);
+    }
+    
+    put_uint32(bytes, crc ^ 0xffffffff);
+    fwrite(bytes, 4, 1, file);
+}
+
+/* Size of the zlib stream of an image made of stored deflate blocks: a
+ * two-byte header, five bytes per block and a four-byte checksum */
+static size_t png_stream_size(int width, int height) {
+    size_t raw;
+    
+    raw = (size_t)height * (1 + 3 * width);
+    
+    return 2 + 5 * ((raw + PNG_STORED_BLOCK - 1) / PNG_STORED_BLOCK) + raw + 4;
+}
+
+static bool write_png(recorder_t *recorder, const uint32_t *pixels) {
+    FILE        *file;
+    char         name[FILENAME_MAX];
+    uint8_t      header[13];
+    uint8_t     *block;
+    uint8_t     *dest;
+    uint32_t     a, b;
+    size_t       raw;
+    size_t       size;
+    size_t       idx, idy;
+    int          x, y;
+    bool         status;
+    
+    /* The image data is first put at the end of the buffer, then moved
+     * towards the start block by block to make room for the block headers. */
+    raw     = (size_t)recorder->height * (1 + 3 * recorder->width);
+    dest    = recorder->buffer + recorder->buffer_size - 4 - raw;
+    
+    for(y = 0; y < recorder->height; ++y) {
+        /* no filter */
+        *(dest++) = 0;
+        
+        for(x = 0; x < recorder->width; ++x) {
+            *(dest++) = pixels[x] >> 16;
+            *(dest++) = pixels[x] >> 8;
+            *(dest++) = pixels[x];
+        }
+        
+        pixels += recorder->width;
+    }
+    
+    block       = recorder->buffer + recorder->buffer_size - 4 - raw;
+    dest        = recorder->buffer;
+    *(dest++)   = 0x78;
+    *(dest++)   = 0x01;
+    a           = 1;
+    b           = 0;
+    
+    for(idx = 0; idx < raw; idx += size) {
+        size = raw - idx;
+        
+        if(size > PNG_STORED_BLOCK) {
+            size = PNG_STORED_BLOCK;
+        }
+        
+        /* final block flag, then the size and its complement */
+        *(dest++) = (idx + size == raw);
+        *(dest++) = size;
+        *(dest++) = size >> 8;
+        *(dest++) = ~size;
+        *(dest++) = ~size >> 8;
+        
+        memmove(dest, block + idx, size);
+        
+        for(idy = 0; idy < size; ++idy) {
+            a = (a + dest[idy]) % 65521;
+            b = (b + a) % 65521;
+        }
+        
+        dest += size;
+    }
+    
+    put_uint32(dest, (b << 16) | a);
+    
+    snprintf(name, sizeof(name), recorder->pattern, recorder->frames);
+    
+    file = fopen(name, "wb");
+    
+    if(file == NULL) {
+        return false;
+    }
+    
+    fwrite("\x89PNG\r\n\x1a\n", 8, 1, file);
+    
+    /* 8 bits per channel, RGB */
+    put_uint32(&header[0], recorder->width);
+    put_uint32(&header[4], recorder->height);
+    header[8]   = 8;
+    header[9]   = 2;
+    header[10]  = 0;
+    header[11]  = 0;
+    header[12]  = 0;
+    
+    png_chunk(file, "IHDR", header, sizeof(header));
+    png_chunk(file, "IDAT", recorder->buffer, recorder->buffer_size);
+    png_chunk(file, "IEND", NULL, 0);
+    
+    status = !ferror(file);
+    status = (fclose(file) == 0) && status;
+    
+    return status;
+}
+
+/* BT.601 with the usual limited range, chroma averaged over 2x2 pixels */
+static bool write_y4m(recorder_t *recorder, const uint32_t *pixels) {
+    const uint32_t  *line;
+    uint8_t         *luma;
+    uint8_t         *cb;
+    uint8_t         *cr;
+    int              r, g, b;
+    int              x, y;
+    int              dx, dy;
+    
+    luma    = recorder->buffer;
+    cb      = luma + recorder->width * recorder->height;
+    cr      = cb + (recorder->width / 2) * (recorder->height / 2);
+    
+    for(y = 0; y < recorder->height; ++y) {
+        line = &pixels[y * recorder->width];
+        
+        for(x = 0; x < recorder->width; ++x) {
+            r = (line[x] >> 16) & 0xff;
+            g = (line[x] >> 8)  & 0xff;
+            b =  line[x]        & 0xff;
+            
+            *(luma++) = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        }
+    }
+    
+    for(y = 0; y < recorder->height; y += 2) {
+        for(x = 0; x < recorder->width; x += 2) {
+            r = g = b = 0;
+            
+            for(dy = 0; dy < 2; ++dy) {
+                for(dx = 0; dx < 2; ++dx) {
+                    r += (pixels[(y + dy) * recorder->width + x + dx] >> 16) & 0xff;
+                    g += (pixels[(y + dy) * recorder->width + x + dx] >> 8)  & 0xff;
+                    b +=  pixels[(y + dy) * recorder->width + x + dx]        & 0xff;
+                }
+            }
+            
+            *(cb++) = ((-38 * r -  74 * g + 112 * b + 512) >> 10) + 128;
+            *(cr++) = ((112 * r -  94 * g -  18 * b + 512) >> 10) + 128;
+        }
+    }
+    
+    fputs("FRAME\n", recorder->file);
+    
+    return fwrite(recorder->buffer, recorder->buffer_size, 1, recorder->file) == 1;
+}
+
+static void *encode_thread(void *param) {
+    recorder_t  *recorder;
+    uint32_t    *pixels;
+    bool         written;
+    
+    recorder = param;
+    
+    while(1) {
+        pthread_mutex_lock(&recorder->mutex);
+        
+        while(!recorder->pending && !recorder->stop) {
+            pthread_cond_wait(&recorder->cond, &recorder->mutex);
+        }
+        
+        if(!recorder->pending) {
+            pthread_mutex_unlock(&recorder->mutex);
+            break;
+        }
+        
+        pixels              = recorder->filling;
+        recorder->filling   = recorder->encoding;
+        recorder->encoding  = pixels;
+        recorder->pending   = false;
+        
+        pthread_cond_broadcast(&recorder->cond);
+        pthread_mutex_unlock(&recorder->mutex);
+        
+        if(recorder->error) {
+            continue;
+        }
+        
+        if(recorder->format == RECORDER_FORMAT_PNG) {
+            written = write_png(recorder, pixels);
+        }
+        else {
+            written = write_y4m(recorder, pixels);
+        }
+        
+        if(!written) {
+            fprintf(stderr, "Cannot write frame %d\n", recorder->frames);
+            recorder->error = true;
+        }
+        
+        ++recorder->frames;
+    }
+    
+    return NULL;
+}
+
+/* The file name of PNG frames is used as a printf() format for the frame
+ * number, so it must contain exactly one %d conversion, optionally with a zero
+ * flag and a width, and any other % must be escaped as %%. */
+static bool png_pattern_valid(const char *pattern) {
+    int conversions;
+    
+    conversions = 0;
+    
+    while((pattern = strchr(pattern, '%')) != NULL) {
+        ++pattern;
+        
+        if(*pattern == '%') {
+            ++pattern;
+            continue;
+        }
+        
+        pattern += strspn(pattern, "0123456789");
+        
+        if(*pattern != 'd') {
+            return false;
+        }
+        
+        ++pattern;
+        ++conversions;
+    }
+    
+    return conversions == 1;
+}
+
+/* Record frames of this size and rate (in frames per second). If the path
+ * ends with ".png", it is a printf() format for the file name of each frame
+ * with the frame number, e.g. "frame%05d.png" (see png_pattern_valid()).
+ * Otherwise, frames are written
+ * in YUV4MPEG2 format to that file, to the standard output if the path is
+ * "-", or to the standard input of a command if the path starts with "|",
+ * e.g. "|ffmpeg -i - critters.mp4". For YUV4MPEG2, the width and height must
+ * be even. */
+recorder_t *recorder_new(const char *path, int width, int height, int rate) {
+    recorder_t  *recorder;
+    size_t       length;
+    size_t       pixels;
+    
+    recorder = qrt_new(recorder_t);
+    
+    if(recorder == NULL) {
+        return NULL;
+    }
+    
+    length              = strlen(path);
+    pixels              = (size_t)width * height;
+    recorder->width     = width;
+    recorder->height    = height;
+    recorder->frames    = 0;
+    recorder->dropped   = 0;
+    recorder->pending   = false;
+    recorder->stop      = false;
+    recorder->error     = false;
+    recorder->pipe      = false;
+    recorder->file      = NULL;
+    recorder->pattern   = NULL;
+    
+    if(length >= 4 && strcmp(&path[length - 4], ".png") == 0) {
+        recorder->format        = RECORDER_FORMAT_PNG;
+        recorder->pattern       = png_pattern_valid(path) ? strdup(path) : NULL;
+        recorder->buffer_size   = png_stream_size(width, height);
+        
+        crc_table_init();
+    }
+    else {
+        recorder->format        = RECORDER_FORMAT_Y4M;
+        recorder->buffer_size   = pixels + 2 * (pixels / 4);
+        
+        if(strcmp(path, "-") == 0) {
+            recorder->file = stdout;
+        }
+        else if(path[0] == '|') {
+            recorder->file = popen(&path[1], "w");
+            recorder->pipe = (recorder->file != NULL);
+        }
+        else {
+            recorder->file = fopen(path, "wb");
+        }
+        
+        if(recorder->file != NULL) {
+            fprintf(recorder->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, rate);
+        }
+    }
+    
+    recorder->filling   = malloc(pixels * sizeof(uint32_t));
+    recorder->encoding  = malloc(pixels * sizeof(uint32_t));
+    recorder->buffer    = malloc(recorder->buffer_size);
+    
+    if((recorder->file == NULL && recorder->pattern == NULL) || recorder->filling == NULL || recorder->encoding == NULL || recorder->buffer == NULL) {
+        recorder->stop = true;
+        recorder_free(recorder);
+        return NULL;
+    }
+    
+    pthread_mutex_init(&recorder->mutex, NULL);
+    pthread_cond_init(&recorder->cond, NULL);
+    
+    if(pthread_create(&recorder->thread, NULL, encode_thread, recorder) != 0) {
+        pthread_mutex_destroy(&recorder->mutex);
+        pthread_cond_destroy(&recorder->cond);
+        recorder->stop = true;
+        recorder_free(recorder);
+        return NULL;
+    }
+    
+    return recorder;
+}
+
+/* Write the pending frame, if any, then stop recording */
+void recorder_free(recorder_t *recorder) {
+    if(recorder == NULL) {
+        return;
+    }
+    
+    /* if stop is already set, the encoder thread was never started */
+    if(!recorder->stop) {
+        pthread_mutex_lock(&recorder->mutex);
+        recorder->stop = true;
+        pthread_cond_broadcast(&recorder->cond);
+        pthread_mutex_unlock(&recorder->mutex);
+        
+        pthread_join(recorder->thread, NULL);
+        pthread_mutex_destroy(&recorder->mutex);
+        pthread_cond_destroy(&recorder->cond);
+    }
+    
+    if(recorder->pipe) {
+        pclose(recorder->file);
+    }
+    else if(recorder->file != NULL && recorder->file != stdout) {
+        fclose(recorder->file);
+    }
+    else if(recorder->file == stdout) {
+        fflush(stdout);
+    }
+    
+    free(recorder->pattern);
+    free(recorder->filling);
+    free(recorder->encoding);
+    free(recorder->buffer);
+    free(recorder);
+}
+
+/* Copy the frame, which must have the size given to recorder_new(), for the
+ * encoder thread. Returns false if the frame is dropped because the encoder
+ * has not yet taken the previous one. */
+bool recorder_submit(recorder_t *recorder, SDL_Surface *frame) {
+    bool     pending;
+    int      y;
+    
+    pthread_mutex_lock(&recorder->mutex);
+    pending = recorder->pending;
+    
+    if(pending) {
+        ++recorder->dropped;
+    }
+    
+    pthread_mutex_unlock(&recorder->mutex);
+    
+    if(pending) {
+        return false;
+    }
+    
+    /* the encoder does not access this buffer until pending is set */
+    for(y = 0; y < recorder->height; ++y) {
+        memcpy(
+            &recorder->filling[y * recorder->width],
+            (uint8_t *)frame->pixels + y * frame->pitch,
+            recorder->width * sizeof(uint32_t));
+    }
+    
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->pending = true;
+    pthread_cond_broadcast(&recorder->cond);
+    pthread_mutex_unlock(&recorder->mutex);
+    
+    return true;
+}
+
+/* Wait until the encoder has taken the last frame submitted, so the next one
+ * is not dropped. This is for recordings where no frame must be lost and the
+ * simulation can wait for the encoder. */
+void recorder_sync(recorder_t *recorder) {
+    pthread_mutex_lock(&recorder->mutex);
+    
+    while(recorder->pending) {
+        pthread_cond_wait(&recorder->cond, &recorder->mutex);
+    }
+    
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+int recorder_get_format(recorder_t *recorder) {
+    return recorder->format;
+}
+
+int recorder_get_dropped(recorder_t *recorder) {
+    int dropped;
+    
+    pthread_mutex_lock(&recorder->mutex);
+    dropped = recorder->dropped;
+    pthread_mutex_unlock(&recorder->mutex);
+    
+    return dropped;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <quatre/macros.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "frame.h"
+#include "renderer.h"
+
+/* A thread that renders a window at a fixed rate from snapshots of its scene,
+ * independently of the thread that updates the scene.
+ * 
+ * There are three snapshots: the one the updating thread is writing, the last
+ * complete one and the one being rendered. Under the lock, the writer swaps
+ * the one it just wrote with the last complete one, and the render thread
+ * swaps the one it rendered with the last complete one if it is newer, so
+ * neither thread ever waits for the other to finish with a snapshot. */
+struct renderer_t {
+    window_t            *window;
+    scene_snapshot_t    *back;
+    scene_snapshot_t    *ready;
+    scene_snapshot_t    *front;
+    pthread_mutex_t      mutex;
+    pthread_t            thread;
+    int                  rate;
+    bool                 fresh;
+    bool                 invalid;
+    bool                 stop;
+};
+
+static void *render_thread(void *param) {
+    renderer_t          *renderer;
+    scene_snapshot_t    *snapshot;
+    frame_clock_t        clock;
+    bool                 fresh;
+    bool                 invalid;
+    bool                 rendered;
+    bool                 stop;
+    
+    renderer = param;
+    rendered = false;
+    
+    frame_clock_init(&clock, renderer->rate);
+    
+    while(1) {
+        pthread_mutex_lock(&renderer->mutex);
+        
+        fresh   = renderer->fresh;
+        invalid = renderer->invalid;
+        stop    = renderer->stop;
+        
+        renderer->invalid = false;
+        
+        if(fresh) {
+            snapshot            = renderer->front;
+            renderer->front     = renderer->ready;
+            renderer->ready     = snapshot;
+            renderer->fresh     = false;
+        }
+        
+        pthread_mutex_unlock(&renderer->mutex);
+        
+        if(stop) {
+            break;
+        }
+        
+        /* The window state used to update only what changed belongs to
+         * this thread, so this is where it is invalidated. */
+        if(invalid) {
+            window_invalidate(renderer->window);
+        }
+        
+        /* nothing moved since the last frame otherwise */
+        if(fresh || (invalid && rendered)) {
+            window_render_snapshot(renderer->window, renderer->front);
+            rendered = true;
+        }
+        
+        frame_clock_wait(&clock);
+    }
+    
+    return NULL;
+}
+
+/* Start rendering the window at this rate, in frames per second. Nothing is
+ * rendered until a snapshot is submitted with renderer_submit(). */
+renderer_t *renderer_new(window_t *window, int rate) {
+    renderer_t      *renderer;
+    pthread_attr_t   attr;
+    int              status;
+    
+    renderer = qrt_new(renderer_t);
+    
+    if(renderer == NULL) {
+        return NULL;
+    }
+    
+    renderer->window    = window;
+    renderer->rate      = rate;
+    renderer->fresh     = false;
+    renderer->invalid   = false;
+    renderer->stop      = false;
+    renderer->back      = scene_snapshot_new();
+    renderer->ready     = scene_snapshot_new();
+    renderer->front     = scene_snapshot_new();
+    
+    if(renderer->back == NULL || renderer->ready == NULL || renderer->front == NULL) {
+        scene_snapshot_free(renderer->back);
+        scene_snapshot_free(renderer->ready);
+        scene_snapshot_free(renderer->front);
+        free(renderer);
+        return NULL;
+    }
+    
+    pthread_mutex_init(&renderer->mutex, NULL);
+    
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    
+    status = pthread_create(&renderer->thread, &attr, render_thread, renderer);
+    
+    pthread_attr_destroy(&attr);
+    
+    if(status != 0) {
+        pthread_mutex_destroy(&renderer->mutex);
+        scene_snapshot_free(renderer->back);
+        scene_snapshot_free(renderer->ready);
+        scene_snapshot_free(renderer->front);
+        free(renderer);
+        return NULL;
+    }
+    
+    return renderer;
+}
+
+/* Stop the render thread and wait for it to finish its frame */
+void renderer_free(renderer_t *renderer) {
+    if(renderer != NULL) {
+        pthread_mutex_lock(&renderer->mutex);
+        renderer->stop = true;
+        pthread_mutex_unlock(&renderer->mutex);
+        
+        pthread_join(renderer->thread, NULL);
+        pthread_mutex_destroy(&renderer->mutex);
+        
+        scene_snapshot_free(renderer->back);
+        scene_snapshot_free(renderer->ready);
+        scene_snapshot_free(renderer->front);
+    }
+    
+    free(renderer);
+}
+
+/* Take a snapshot of the scene of the window (see window_snapshot()), which
+ * the render thread renders in its next frame unless another one is submitted
+ * before. This must be called by the thread that updates the scene. */
+void renderer_submit(renderer_t *renderer) {
+    scene_snapshot_t *snapshot;
+    
+    window_snapshot(renderer->window, renderer->back);
+    
+    pthread_mutex_lock(&renderer->mutex);
+    
+    snapshot            = renderer->ready;
+    renderer->ready     = renderer->back;
+    renderer->back      = snapshot;
+    renderer->fresh     = true;
+    
+    pthread_mutex_unlock(&renderer->mutex);
+}
+
+/* Redraw the whole window in the next frame, e.g. when it has been exposed.
+ * This must be used instead of window_invalidate() while the render thread
+ * is running. */
+void renderer_invalidate(renderer_t *renderer) {
+    pthread_mutex_lock(&renderer->mutex);
+    renderer->invalid = true;
+    pthread_mutex_unlock(&renderer->mutex);
+}
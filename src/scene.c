@@ -32,6 +32,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include "brain.h"
 #include "critter.h"
 #include "danger.h"
 #include "food.h"
@@ -45,26 +46,79 @@
 
 #define SCENT_DISTANCE_LIMIT    250.0
 
+/* With SCENE_PRECISION_FIXED, positions are rounded to this fraction of a
+ * pixel, which is what a 16-bit fixed-point value can hold for a coordinate
+ * up to 2048 pixels. */
+#define FIXED_POSITION_SCALE    16.0
 
-#define SCENE_THINGS    (SCENE_FOODS + SCENE_DANGERS)
+/* Maximum number of critters whose brains are computed in one batch */
+#define SCENE_BRAIN_BATCH       32
+
+/* Things that moved by more than this distance, in pixels, between two
+ * snapshots are not interpolated (see scene_snapshot_interpolate()) */
+#define SNAPSHOT_JUMP_DISTANCE  50.0
 
 
 typedef void (*render_func_t)(scene_t *, int, int);
 
 
+/* Copies of the things and critters of a scene as they were at some point,
+ * for rendering only. A snapshot does not refer to anything in the scene, so
+ * it can be rendered in another thread while the scene is updated. */
+struct scene_snapshot_t {
+    critter_appearance_t    *critter;
+    food_t                   food[SCENE_FOODS];
+    danger_t                 danger[SCENE_DANGERS];
+    int                      critters;
+    int                      capacity;  /* critters allocated */
+    int                      width;
+    int                      height;
+};
+
+
 struct scene_t {
-    int          width;
-    int          height;
-    critter_t   *critter;
-    thing_t     *thing[SCENE_THINGS];
+    int                      width;
+    int                      height;
+    critter_t               *critter;
+    thing_t                 *thing[SCENE_THINGS];
+    const scene_script_t    *script;
+    int                      script_x;
+    int                      script_y;
+    int                      precision;
 };
 
-static inline int random_horizontal_position(const scene_t *scene) {
-    return rand() % scene->width;
+/* When the scene follows a script, the horizontal and vertical positions are
+ * taken from the script with separate cursors so the result does not depend
+ * on the order in which the two functions are called. */
+static inline int random_horizontal_position(scene_t *scene) {
+    float x;
+    
+    if(scene->script == NULL) {
+        return rand() % scene->width;
+    }
+    
+    x = scene->script->x[scene->script_x];
+    scene->script_x = (scene->script_x + 1) & (SCENE_SCRIPT_POSITIONS - 1);
+    
+    return (int)(x * (float)scene->width);
+}
+
+static inline int random_vertical_position(scene_t *scene) {
+    float y;
+    
+    if(scene->script == NULL) {
+        return rand() % scene->height;
+    }
+    
+    y = scene->script->y[scene->script_y];
+    scene->script_y = (scene->script_y + 1) & (SCENE_SCRIPT_POSITIONS - 1);
+    
+    return (int)(y * (float)scene->height);
 }
 
-static inline int random_vertical_position(const scene_t *scene) {
-    return rand() % scene->height;
+static inline float random_fraction(void) {
+    /* in the range [0, 1) */
+    return (float)rand() / ((float)RAND_MAX + 1.0);
 }
 
 scene_t *scene_new(void) {
@@ -80,6 +134,10 @@ scene_t *scene_new(void) {
     if(scene != NULL) {
         scene->width    = SCENE_WIDTH;
         scene->height   = SCENE_HEIGHT;
+        scene->script   = NULL;
+        scene->script_x = 0;
+        scene->script_y = 0;
+        scene->precision = SCENE_PRECISION_FLOAT;
         something_null  = false;
         
         thing_ptr = scene->thing;
@@ -175,7 +233,7 @@ static bool compute_stimuli(stimuli_t*stimuli, critter_t *critter, scene_t *scen
     float                intensity;
     int                  idx;
         
-    critter_angle = critter->angle;
+    critter_angle = critter->appearance.angle;
 
     /* We store angles in the range -pi..pi. If the critter is looking 
      * in a direction close to -pi or pi, we convert the range to 0..2*pi
@@ -360,13 +418,29 @@ static bool compute_stimuli(stimuli_t*stimuli, critter_t *critter, scene_t *scen
     return true;
 }
 
+static inline void round_position(thing_t *thing) {
+    thing_set_position(
+            thing,
+            roundf(thing_get_x(thing) * FIXED_POSITION_SCALE) * (1.0 / FIXED_POSITION_SCALE),
+            roundf(thing_get_y(thing) * FIXED_POSITION_SCALE) * (1.0 / FIXED_POSITION_SCALE));
+}
+
 void scene_update(scene_t *scene, float delta) {
     critter_t   *critter;
-    stimuli_t    stimuli;
+    stimuli_t    stimuli[SCENE_BRAIN_BATCH];
+    brain_job_t  jobs[SCENE_BRAIN_BATCH];
+    bool         fixed;
+    int          count;
     int          idx;
     
+    fixed = (scene->precision == SCENE_PRECISION_FIXED);
+    
     for(idx = 0; idx < SCENE_THINGS; ++idx) {
         thing_update_position(scene->thing[idx], delta, scene->width, scene->height);
+        
+        if(fixed) {
+            round_position(scene->thing[idx]);
+        }
     }
     
     idx = 0;
@@ -375,27 +449,79 @@ void scene_update(scene_t *scene, float delta) {
     while(critter != NULL) {
         critter_update_position(critter, delta, scene->width, scene->height);
         
+        if(fixed) {
+            round_position(critter_get_thing(critter));
+        }
+        
         critter = critter->next;
         ++idx;
     }
     
+    /* The brains are computed in batches once the stimuli of all critters of
+     * the batch are known. This does not change the result since the brain
+     * controls are only used by the next position update. */
     critter = scene->critter;
+    count   = 0;
     
     while(critter != NULL) {
-        if( compute_stimuli(&stimuli, critter, scene) ) {
-            critter_update_brain(critter, &stimuli);
+        if( compute_stimuli(&stimuli[count], critter, scene) ) {
+            switch(scene->precision) {
+            case SCENE_PRECISION_FIXED:
+                critter_update_brain_fixed(critter, &stimuli[count]);
+                break;
+            case SCENE_PRECISION_INT8:
+                critter_update_brain_int8(critter, &stimuli[count]);
+                break;
+            default:
+                critter_brain_job(critter, &jobs[count], &stimuli[count]);
+                
+                if(++count == SCENE_BRAIN_BATCH) {
+                    brain_control_compute_batch(jobs, count);
+                    count = 0;
+                }
+            }
         }
         
         critter = critter->next;
     }
+    
+    brain_control_compute_batch(jobs, count);
 }
 
+/* The positions of the critters and things are scaled proportionally, so
+ * they stay where they were relative to the scene and within bounds. */
 void scene_resize(scene_t *scene, int width, int height) {
+    critter_t   *critter;
+    thing_t     *thing;
+    float        scale_x;
+    float        scale_y;
+    int          idx;
+    
+    scale_x = (float)width  / (float)scene->width;
+    scale_y = (float)height / (float)scene->height;
+    
     scene->width    = width;
     scene->height   = height;
     
-    /* This ensures all coordinates are within bounds. */
-    scene_shake(scene);
+    critter = scene->critter;
+    
+    while(critter != NULL) {
+        critter_set_position(
+                critter,
+                critter_get_x(critter) * scale_x,
+                critter_get_y(critter) * scale_y);
+        
+        critter = critter->next;
+    }
+    
+    for(idx = 0; idx < SCENE_THINGS; ++idx) {
+        thing = scene->thing[idx];
+        
+        thing_set_position(
+                thing,
+                thing_get_x(thing) * scale_x,
+                thing_get_y(thing) * scale_y);
+    }
 }
 
 void scene_shake(scene_t *scene) {
@@ -424,6 +550,99 @@ void scene_shake(scene_t *scene) {
     }
 }
 
+void scene_script_generate(scene_script_t *script) {
+    int idx;
+    
+    for(idx = 0; idx < SCENE_THINGS; ++idx) {
+        script->dir[idx] = rand();
+    }
+    
+    for(idx = 0; idx < SCENE_SCRIPT_POSITIONS; ++idx) {
+        script->x[idx] = random_fraction();
+        script->y[idx] = random_fraction();
+    }
+}
+
+static void start_script(scene_t *scene, const scene_script_t *script) {
+    int idx;
+    
+    scene->script   = script;
+    scene->script_x = 0;
+    scene->script_y = 0;
+    
+    if(script == NULL) {
+        return;
+    }
+    
+    /* The first SCENE_FOODS things are food, the rest are dangers (see
+     * scene_new()). */
+    for(idx = 0; idx < SCENE_THINGS; ++idx) {
+        if(idx < SCENE_FOODS) {
+            food_set_direction((food_t *)scene->thing[idx], script->dir[idx]);
+        }
+        else {
+            danger_set_direction((danger_t *)scene->thing[idx], script->dir[idx]);
+        }
+        
+        thing_set_position(
+                scene->thing[idx],
+                random_horizontal_position(scene),
+                random_vertical_position(scene));
+    }
+}
+
+/* Start following a script from its beginning, or stop following a script if
+ * script is NULL. Things, as well as any critters already in the scene, are
+ * moved to their initial positions. */
+void scene_set_script(scene_t *scene, const scene_script_t *script) {
+    critter_t   *critter;
+    
+    start_script(scene, script);
+    
+    if(script == NULL) {
+        return;
+    }
+    
+    critter = scene->critter;
+    
+    while(critter != NULL) {
+        critter_set_position(
+                critter,
+                random_horizontal_position(scene),
+                random_vertical_position(scene));
+        
+        critter->appearance.angle = 0.0;
+        (void)brain_control_init(&critter->brain_control);
+        brain_state_init(&critter->brain_state);
+        
+        critter = critter->next;
+    }
+}
+
+/* Like scene_set_script(), except that the critters already in the scene are
+ * left as they are: they keep their position, angle and brain state. This is
+ * used to continue a run in another scene. */
+void scene_continue_script(scene_t *scene, const scene_script_t *script) {
+    start_script(scene, script);
+}
+
+/* Select the precision of the simulation: SCENE_PRECISION_FLOAT (the default)
+ * or SCENE_PRECISION_FIXED. With SCENE_PRECISION_FIXED, the brain computes
+ * with 16-bit fixed-point weights, stimuli and activations, and positions are
+ * rounded to what a 16-bit fixed-point value can hold. With
+ * SCENE_PRECISION_INT8, the brain computes with 8-bit weights instead (see
+ * brain_int8_t) and positions are not rounded. This is meant for comparing
+ * the speed and the accuracy of all three (see precision-study.c). Topologies
+ * not supported by the fixed-point brain (see brain_fixed_supported()) stay
+ * in floating point. */
+void scene_set_precision(scene_t *scene, int precision) {
+    if(precision != SCENE_PRECISION_FLOAT && !brain_fixed_supported()) {
+        precision = SCENE_PRECISION_FLOAT;
+    }
+    
+    scene->precision = precision;
+}
+
 void scene_add_critter(scene_t *scene, critter_t *critter) {
     critter_set_position(
             critter,
@@ -446,6 +665,21 @@ critter_t *scene_harvest_critter(scene_t *scene) {
     return critter;
 }
 
+void scene_remove_critter(scene_t *scene, critter_t *critter) {
+    critter_t  **prev_ptr;
+    
+    prev_ptr = &scene->critter;
+    
+    while(*prev_ptr != NULL) {
+        if(*prev_ptr == critter) {
+            *prev_ptr = critter->next;
+            return;
+        }
+        
+        prev_ptr = &(*prev_ptr)->next;
+    }
+}
+
 critter_t *scene_first_critter(scene_t *scene) {
     return scene->critter;
 }
@@ -453,3 +687,304 @@ critter_t *scene_first_critter(scene_t *scene) {
 critter_t *scene_next_critter(scene_t *scene, critter_t *critter) {
     return critter->next;
 }
+
+/* The storage for critters is allocated as they are taken or copied, for as
+ * many as the largest scene seen, so a snapshot can be used for the scenes of
+ * the GUI and of the breeder alike. */
+scene_snapshot_t *scene_snapshot_new(void) {
+    scene_snapshot_t *snapshot;
+    
+    snapshot = qrt_new(scene_snapshot_t);
+    
+    if(snapshot != NULL) {
+        snapshot->critter   = NULL;
+        snapshot->critters  = 0;
+        snapshot->capacity  = 0;
+        snapshot->width     = SCENE_WIDTH;
+        snapshot->height    = SCENE_HEIGHT;
+    }
+    
+    return snapshot;
+}
+
+void scene_snapshot_free(scene_snapshot_t *snapshot) {
+    if(snapshot != NULL) {
+        free(snapshot->critter);
+    }
+    
+    free(snapshot);
+}
+
+/* Make room for this number of critters. Returns the number that fit, which
+ * is less only if the allocation fails, in which case the others are not
+ * rendered. */
+static int snapshot_reserve(scene_snapshot_t *snapshot, int critters) {
+    critter_appearance_t *critter;
+    
+    if(critters > snapshot->capacity) {
+        critter = realloc(snapshot->critter, critters * sizeof(critter_appearance_t));
+        
+        if(critter == NULL) {
+            return snapshot->capacity;
+        }
+        
+        snapshot->critter   = critter;
+        snapshot->capacity  = critters;
+    }
+    
+    return critters;
+}
+
+/* The things of a scene are the food items followed by the dangers (see
+ * scene_new()). */
+void scene_snapshot_take(scene_snapshot_t *snapshot, scene_t *scene) {
+    critter_t   *critter;
+    food_t      *food;
+    danger_t    *danger;
+    int          count;
+    int          idx;
+    
+    for(idx = 0; idx < SCENE_FOODS; ++idx) {
+        food  = &snapshot->food[idx];
+        *food = *(food_t *)scene->thing[idx]->this_ptr;
+        food->thing.this_ptr = food;
+    }
+    
+    for(idx = 0; idx < SCENE_DANGERS; ++idx) {
+        danger  = &snapshot->danger[idx];
+        *danger = *(danger_t *)scene->thing[SCENE_FOODS + idx]->this_ptr;
+        danger->thing.this_ptr = danger;
+    }
+    
+    count = 0;
+    
+    for(critter = scene->critter; critter != NULL; critter = critter->next) {
+        ++count;
+    }
+    
+    count   = snapshot_reserve(snapshot, count);
+    critter = scene->critter;
+    
+    for(idx = 0; idx < count; ++idx) {
+        critter_copy_appearance(&snapshot->critter[idx], critter_get_appearance(critter));
+        critter = critter->next;
+    }
+    
+    snapshot->critters  = count;
+    snapshot->width     = scene->width;
+    snapshot->height    = scene->height;
+}
+
+void scene_snapshot_copy(scene_snapshot_t *snapshot, const scene_snapshot_t *source) {
+    int count;
+    int idx;
+    
+    for(idx = 0; idx < SCENE_FOODS; ++idx) {
+        snapshot->food[idx] = source->food[idx];
+        snapshot->food[idx].thing.this_ptr = &snapshot->food[idx];
+    }
+    
+    for(idx = 0; idx < SCENE_DANGERS; ++idx) {
+        snapshot->danger[idx] = source->danger[idx];
+        snapshot->danger[idx].thing.this_ptr = &snapshot->danger[idx];
+    }
+    
+    count = snapshot_reserve(snapshot, source->critters);
+    
+    for(idx = 0; idx < count; ++idx) {
+        critter_copy_appearance(&snapshot->critter[idx], &source->critter[idx]);
+    }
+    
+    snapshot->critters  = count;
+    snapshot->width     = source->width;
+    snapshot->height    = source->height;
+}
+
+/* Returns false if the thing jumped, in which case it is left as it is. */
+static bool interpolate_thing(thing_t *thing, const thing_t *before, float alpha) {
+    float dx, dy;
+    
+    dx = thing->x - before->x;
+    dy = thing->y - before->y;
+    
+    /* captured, or put elsewhere by scene_shake() */
+    if(dx * dx + dy * dy > SNAPSHOT_JUMP_DISTANCE * SNAPSHOT_JUMP_DISTANCE) {
+        return false;
+    }
+    
+    thing->x = before->x + alpha * dx;
+    thing->y = before->y + alpha * dy;
+    
+    return true;
+}
+
+/* Set the snapshot to a state between two snapshots of the same scene, from
+ * before (alpha is 0) to after (alpha is 1). Things that jumped, and critters
+ * that are not in both snapshots, are as they are after, including the angle
+ * of a critter. */
+void scene_snapshot_interpolate(scene_snapshot_t *snapshot, const scene_snapshot_t *before, const scene_snapshot_t *after, float alpha) {
+    critter_appearance_t    *critter;
+    food_t                  *food;
+    danger_t                *danger;
+    float                    delta_angle;
+    int                      count;
+    int                      idx;
+    
+    for(idx = 0; idx < SCENE_FOODS; ++idx) {
+        food  = &snapshot->food[idx];
+        *food = after->food[idx];
+        food->thing.this_ptr = food;
+        
+        (void)interpolate_thing(&food->thing, &before->food[idx].thing, alpha);
+    }
+    
+    for(idx = 0; idx < SCENE_DANGERS; ++idx) {
+        danger  = &snapshot->danger[idx];
+        *danger = after->danger[idx];
+        danger->thing.this_ptr = danger;
+        
+        (void)interpolate_thing(&danger->thing, &before->danger[idx].thing, alpha);
+    }
+    
+    count = snapshot_reserve(snapshot, after->critters);
+    
+    for(idx = 0; idx < count; ++idx) {
+        critter = &snapshot->critter[idx];
+        critter_copy_appearance(critter, &after->critter[idx]);
+        
+        if(idx >= before->critters) {
+            continue;
+        }
+        
+        /* the angle of a critter that jumped is as it is after too */
+        if(!interpolate_thing(&critter->thing, &before->critter[idx].thing, alpha)) {
+            continue;
+        }
+        
+        /* the short way around */
+        delta_angle = critter->angle - before->critter[idx].angle;
+        
+        if(delta_angle > M_PI) {
+            delta_angle -= 2 * M_PI;
+        }
+        else if(delta_angle < -M_PI) {
+            delta_angle += 2 * M_PI;
+        }
+        
+        critter->angle = before->critter[idx].angle + alpha * delta_angle;
+    }
+    
+    snapshot->critters  = count;
+    snapshot->width     = after->width;
+    snapshot->height    = after->height;
+}
+
+/* Same as scene_render() for the scene from which the snapshot was taken */
+void scene_snapshot_render(scene_snapshot_t *snapshot, SDL_Surface *screen, int v_offset, int h_offset) {
+    int idx;
+    
+    for(idx = 0; idx < SCENE_FOODS; ++idx) {
+        food_render(&snapshot->food[idx], screen, v_offset, h_offset);
+    }
+    
+    for(idx = 0; idx < SCENE_DANGERS; ++idx) {
+        danger_render(&snapshot->danger[idx], screen, v_offset, h_offset);
+    }
+    
+    for(idx = 0; idx < snapshot->critters; ++idx) {
+        critter_appearance_render(&snapshot->critter[idx], screen, v_offset, h_offset);
+    }
+}
+
+static void render_dot(SDL_Surface *screen, const SDL_Rect *rect, float scale, thing_t *thing, Uint32 colour) {
+    SDL_Rect     dot;
+    int          size;
+    
+    /* at least one pixel */
+    size    = (int)(2.0 * thing->bound * scale);
+    size    = (size < 1) ? 1 : size;
+    
+    dot.x   = rect->x + (int)(thing->x * scale) - size / 2;
+    dot.y   = rect->y + (int)(thing->y * scale) - size / 2;
+    dot.w   = size;
+    dot.h   = size;
+    
+    /* within the rectangle */
+    if(dot.x < rect->x) {
+        dot.x = rect->x;
+    }
+    
+    if(dot.y < rect->y) {
+        dot.y = rect->y;
+    }
+    
+    if(dot.x + size > rect->x + rect->w) {
+        dot.x = rect->x + rect->w - size;
+    }
+    
+    if(dot.y + size > rect->y + rect->h) {
+        dot.y = rect->y + rect->h - size;
+    }
+    
+    SDL_FillRect(screen, &dot, colour);
+}
+
+/* Render the snapshot scaled down to fit within the rectangle, with each
+ * thing drawn as a square of its colour (the colour of the head for critters)
+ * instead of its sprite. */
+void scene_snapshot_render_dots(scene_snapshot_t *snapshot, SDL_Surface *screen, const SDL_Rect *rect) {
+    float        scale;
+    int          idx;
+    
+    scale = (float)rect->w / (float)snapshot->width;
+    
+    if((float)rect->h / (float)snapshot->height < scale) {
+        scale = (float)rect->h / (float)snapshot->height;
+    }
+    
+    for(idx = 0; idx < SCENE_FOODS; ++idx) {
+        render_dot(screen, rect, scale, &snapshot->food[idx].thing, snapshot->food[idx].thing.colour);
+    }
+    
+    for(idx = 0; idx < SCENE_DANGERS; ++idx) {
+        render_dot(screen, rect, scale, &snapshot->danger[idx].thing, snapshot->danger[idx].thing.colour);
+    }
+    
+    for(idx = 0; idx < snapshot->critters; ++idx) {
+        render_dot(screen, rect, scale, &snapshot->critter[idx].thing, snapshot->critter[idx].head_colour);
+    }
+}
+
+int scene_snapshot_get_width(scene_snapshot_t *snapshot) {
+    return snapshot->width;
+}
+
+int scene_snapshot_get_height(scene_snapshot_t *snapshot) {
+    return snapshot->height;
+}
+
+/* Same as scene_get_rects() for the scene from which the snapshot was taken */
+int scene_snapshot_get_rects(scene_snapshot_t *snapshot, SDL_Rect *rects, int max, int v_offset, int h_offset) {
+    int count;
+    int idx;
+    
+    if(max < SCENE_THINGS + snapshot->critters) {
+        return -1;
+    }
+    
+    count = 0;
+    
+    for(idx = 0; idx < SCENE_FOODS; ++idx) {
+        thing_get_rect(food_get_thing(&snapshot->food[idx]), &rects[count++], v_offset, h_offset);
+    }
+    
+    for(idx = 0; idx < SCENE_DANGERS; ++idx) {
+        thing_get_rect(danger_get_thing(&snapshot->danger[idx]), &rects[count++], v_offset, h_offset);
+    }
+    
+    for(idx = 0; idx < snapshot->critters; ++idx) {
+        thing_get_rect(&snapshot->critter[idx].thing, &rects[count++], v_offset, h_offset);
+    }
+    
+    return count;
+}
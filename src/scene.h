@@ -41,9 +41,42 @@
 
 #define SCENE_DANGERS    2
 
+#define SCENE_THINGS    (SCENE_FOODS + SCENE_DANGERS)
+
+/* Number of positions in a scene script. Must be a power of two, since the
+ * positions are taken in turn with a mask. */
+#define SCENE_SCRIPT_POSITIONS  64
+
+#if SCENE_SCRIPT_POSITIONS & (SCENE_SCRIPT_POSITIONS - 1)
+#error "SCENE_SCRIPT_POSITIONS must be a power of two"
+#endif
+
+/* Precision of the simulation (see scene_set_precision()) */
+#define SCENE_PRECISION_FLOAT   0
+
+#define SCENE_PRECISION_FIXED   1
+
+#define SCENE_PRECISION_INT8    2
+
 
 typedef struct scene_t scene_t;
 
+typedef struct scene_script_t scene_script_t;
+
+typedef struct scene_snapshot_t scene_snapshot_t;
+
+/* A scene script replaces the random numbers used by a scene with a sequence
+ * that is generated in advance. Scenes that follow the same script start with
+ * the same things at the same positions going in the same directions, and
+ * food that is captured reappears at the same sequence of positions. A script
+ * is never modified by the scenes that follow it, so it can be shared by
+ * scenes in different threads. */
+struct scene_script_t {
+    int     dir[SCENE_THINGS];
+    float   x[SCENE_SCRIPT_POSITIONS];  /* fraction of the width */
+    float   y[SCENE_SCRIPT_POSITIONS];  /* fraction of the height */
+};
+
 scene_t *scene_new(void);
 
 void scene_free(scene_t *scene);
@@ -56,12 +89,42 @@ void scene_resize(scene_t *scene, int width, int height);
 
 void scene_shake(scene_t *scene);
 
+void scene_script_generate(scene_script_t *script);
+
+void scene_set_script(scene_t *scene, const scene_script_t *script);
+
+void scene_continue_script(scene_t *scene, const scene_script_t *script);
+
+void scene_set_precision(scene_t *scene, int precision);
+
 void scene_add_critter(scene_t *scene, critter_t *critter);
 
 critter_t *scene_harvest_critter(scene_t *scene);
 
+void scene_remove_critter(scene_t *scene, critter_t *critter);
+
 critter_t *scene_first_critter(scene_t *scene);
 
 critter_t *scene_next_critter(scene_t *scene, critter_t *critter);
 
+scene_snapshot_t *scene_snapshot_new(void);
+
+void scene_snapshot_free(scene_snapshot_t *snapshot);
+
+void scene_snapshot_take(scene_snapshot_t *snapshot, scene_t *scene);
+
+void scene_snapshot_copy(scene_snapshot_t *snapshot, const scene_snapshot_t *source);
+
+void scene_snapshot_interpolate(scene_snapshot_t *snapshot, const scene_snapshot_t *before, const scene_snapshot_t *after, float alpha);
+
+void scene_snapshot_render(scene_snapshot_t *snapshot, SDL_Surface *screen, int v_offset, int h_offset);
+
+void scene_snapshot_render_dots(scene_snapshot_t *snapshot, SDL_Surface *screen, const SDL_Rect *rect);
+
+int scene_snapshot_get_width(scene_snapshot_t *snapshot);
+
+int scene_snapshot_get_height(scene_snapshot_t *snapshot);
+
+int scene_snapshot_get_rects(scene_snapshot_t *snapshot, SDL_Rect *rects, int max, int v_offset, int h_offset);
+
 #endif
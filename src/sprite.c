@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <emmintrin.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include "sprite.h"
+
+typedef struct {
+    uint64_t     key;
+    bool         valid;
+    sprite_t     sprite;
+} cache_entry_t;
+
+/* Direct-mapped: each key can only be in one entry, which is overwritten by
+ * the next key that maps to it. */
+struct sprite_cache_t {
+    int              size;
+    cache_entry_t   *entries;
+};
+
+/* Call the rendering function of the thing for each pixel of its bounding
+ * box, which must not be larger than SPRITE_MAX_BOUND. The pre-rendering
+ * function, if any, must have been called. */
+void sprite_rasterize(sprite_t *sprite, thing_t *thing) {
+    int idx;
+    int x, y;
+    
+    sprite->bound = thing->bound;
+    
+    for(y = -thing->bound; y < thing->bound; ++y) {
+        idx = (y + thing->bound) * SPRITE_MAX_SIZE;
+        
+        for(x = -thing->bound; x < thing->bound; ++x) {
+            if(thing->render_func(thing->this_ptr, x, y)) {
+                /* the rendering function can change the colour */
+                sprite->colour[idx] = thing->colour;
+                sprite->mask[idx]   = 0xffffffff;
+            }
+            else {
+                sprite->colour[idx] = 0;
+                sprite->mask[idx]   = 0;
+            }
+            
+            ++idx;
+        }
+    }
+}
+
+/* Copy the sprite to the screen with its top-left corner at the given
+ * position, four pixels at a time. Same as the per-pixel rendering, the
+ * bounding box must be entirely within the screen. */
+void sprite_blit(const sprite_t *sprite, SDL_Surface *screen, int v_corner, int h_corner) {
+    const uint32_t  *colour;
+    const uint32_t  *mask;
+    uint32_t        *line_start;
+    __m128i          pixels;
+    __m128i          m;
+    int              size;
+    int              x, y;
+    
+    size        = 2 * sprite->bound;
+    line_start  = (uint32_t *)screen->pixels + v_corner * (screen->pitch / sizeof(uint32_t)) + h_corner;
+    
+    for(y = 0; y < size; ++y) {
+        colour  = &sprite->colour[y * SPRITE_MAX_SIZE];
+        mask    = &sprite->mask[y * SPRITE_MAX_SIZE];
+        
+        for(x = 0; x + 4 <= size; x += 4) {
+            m       = _mm_load_si128((const __m128i *)&mask[x]);
+            pixels  = _mm_loadu_si128((const __m128i *)&line_start[x]);
+            pixels  = _mm_or_si128(_mm_andnot_si128(m, pixels), _mm_load_si128((const __m128i *)&colour[x]));
+            
+            _mm_storeu_si128((__m128i *)&line_start[x], pixels);
+        }
+        
+        for(; x < size; ++x) {
+            line_start[x] = (line_start[x] & ~mask[x]) | colour[x];
+        }
+        
+        line_start += screen->pitch / sizeof(uint32_t);
+    }
+}
+
+sprite_cache_t *sprite_cache_new(int size) {
+    sprite_cache_t  *cache;
+    int              idx;
+    
+    cache = malloc(sizeof(sprite_cache_t));
+    
+    if(cache == NULL) {
+        return NULL;
+    }
+    
+    cache->size     = size;
+    cache->entries  = memalign(__alignof__(cache_entry_t), size * sizeof(cache_entry_t));
+    
+    if(cache->entries == NULL) {
+        free(cache);
+        return NULL;
+    }
+    
+    for(idx = 0; idx < size; ++idx) {
+        cache->entries[idx].valid = false;
+    }
+    
+    return cache;
+}
+
+void sprite_cache_free(sprite_cache_t *cache) {
+    if(cache != NULL) {
+        free(cache->entries);
+        free(cache);
+    }
+}
+
+/* Sprite for this key. If hit is false on return, the sprite is not (or no
+ * longer) that of this key and the caller must rasterize it. */
+sprite_t *sprite_cache_get(sprite_cache_t *cache, uint64_t key, bool *hit) {
+    cache_entry_t   *entry;
+    uint64_t         hash;
+    
+    /* Fibonacci hashing */
+    hash    = key * 0x9e3779b97f4a7c15ull;
+    entry   = &cache->entries[(hash >> 32) % cache->size];
+    
+    *hit = entry->valid && entry->key == key;
+    
+    entry->key      = key;
+    entry->valid    = true;
+    
+    return &entry->sprite;
+}
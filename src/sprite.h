@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CRITTERS_SPRITE_H_
+#define CRITTERS_SPRITE_H_
+
+#include <SDL/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "thing.h"
+
+/* Largest bounding box size (see thing_t) of a sprite, in pixels */
+#define SPRITE_MAX_BOUND    16
+
+#define SPRITE_MAX_SIZE     (2 * SPRITE_MAX_BOUND)
+
+
+typedef struct sprite_cache_t sprite_cache_t;
+
+/* The image of a thing, rasterized once with its rendering function and then
+ * copied to the screen as many times as needed. For each pixel of the bounding
+ * box, the colour and a mask that is all ones where the thing is drawn and
+ * zero elsewhere. Rows are SPRITE_MAX_SIZE pixels apart. */
+struct sprite_t {
+    uint32_t     colour[SPRITE_MAX_SIZE * SPRITE_MAX_SIZE];
+    uint32_t     mask[SPRITE_MAX_SIZE * SPRITE_MAX_SIZE];
+    int          bound;
+} __attribute__ ((aligned (16)));
+
+
+void sprite_rasterize(sprite_t *sprite, thing_t *thing);
+
+void sprite_blit(const sprite_t *sprite, SDL_Surface *screen, int v_corner, int h_corner);
+
+sprite_cache_t *sprite_cache_new(int size);
+
+void sprite_cache_free(sprite_cache_t *cache);
+
+sprite_t *sprite_cache_get(sprite_cache_t *cache, uint64_t key, bool *hit);
+
+#endif
@@ -27,6 +27,7 @@
  */
 
 #include <SDL/SDL.h>
+#include "sprite.h"
 #include "thing.h"
 
 bool thing_init(
@@ -39,6 +40,7 @@ bool thing_init(
         void                    *this_ptr,
         thing_render_func_t      func,
         thing_pre_render_func_t  pre_func,
+        thing_sprite_func_t      sprite_func,
         thing_update_func_t      update_func,
         thing_free_func_t        free_func) {
             
@@ -50,6 +52,7 @@ bool thing_init(
     thing->this_ptr     = this_ptr;
     thing->render_func  = func;
     thing->pre_func     = pre_func;
+    thing->sprite_func  = sprite_func;
     thing->update_func  = update_func;
     thing->free_func    = free_func;
     
@@ -63,15 +66,22 @@ void thing_render(thing_t *thing, SDL_Surface *screen, int v_offset, int h_offse
     int          v_corner, h_corner;
     int          x, y;
     
+    v_corner    = v_offset + (int)thing->y - thing->bound;
+    h_corner    = h_offset + (int)thing->x - thing->bound;
+    
+    /* Things with a sprite function are rasterized once (see sprite.h), the
+     * others are rendered pixel by pixel. */
+    if(thing->sprite_func != NULL) {
+        sprite_blit(thing->sprite_func(thing->this_ptr), screen, v_corner, h_corner);
+        return;
+    }
+    
     /* prepare state for rendering */
     if(thing->pre_func != NULL) {
         thing->pre_func(thing->this_ptr);
     }
     
     pixel_array = (uint32_t *)screen->pixels;    
-    v_corner    = v_offset + (int)thing->y - thing->bound;
-    h_corner    = h_offset + (int)thing->x - thing->bound;
-    
     line_start  = &pixel_array[v_corner * screen->pitch / sizeof(uint32_t)];
     
     for(y = -thing->bound; y < thing->bound; ++y) {
@@ -42,10 +42,14 @@
 
 typedef struct thing_t thing_t;
 
+typedef struct sprite_t sprite_t;
+
 typedef bool (*thing_render_func_t)(void *this_ptr, int x, int y);
 
 typedef void (*thing_pre_render_func_t)(void *this_ptr);
 
+typedef const sprite_t *(*thing_sprite_func_t)(void *this_ptr);
+
 typedef void (*thing_update_func_t)(void *this_ptr, float delta, float w, float h);
 
 typedef void (*thing_free_func_t)(void *this_ptr);
@@ -60,6 +64,7 @@ struct thing_t {
     void        *this_ptr;
     thing_render_func_t      render_func;
     thing_pre_render_func_t  pre_func;
+    thing_sprite_func_t      sprite_func;
     thing_update_func_t      update_func;
     thing_free_func_t        free_func;
 };
@@ -74,11 +79,20 @@ bool thing_init(
         void                    *this_ptr,
         thing_render_func_t      func,
         thing_pre_render_func_t  pre_func,
+        thing_sprite_func_t      sprite_func,
         thing_update_func_t      update_func,
         thing_free_func_t        free_func);
 
 void thing_render(thing_t *thing, SDL_Surface *screen, int v_offset, int h_offset);
 
+/* Rectangle of the screen covered by thing_render() with the same offsets */
+static inline void thing_get_rect(thing_t *thing, SDL_Rect *rect, int v_offset, int h_offset) {
+    rect->x = h_offset + (int)thing->x - thing->bound;
+    rect->y = v_offset + (int)thing->y - thing->bound;
+    rect->w = 2 * thing->bound;
+    rect->h = 2 * thing->bound;
+}
+
 static inline void thing_update_position(thing_t *thing, float delta, float w, float h) {
     thing->update_func(thing->this_ptr, delta, w, h);
 }
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <quatre/macros.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "frame.h"
+#include "sprite.h"
+#include "tiles.h"
+#include "util.h"
+
+#define COLOUR_TILE_BG      rgb(30, 30, 30)
+
+
+/* A tiled view of the scenes where critters are simulated by the breeder,
+ * side by side and scaled down to fit, from the snapshots published by its
+ * threads (see breeder_enable_snapshots()). */
+struct tiles_t {
+    breeder_t           *breeder;
+    scene_snapshot_t    *snapshot;
+    int64_t             *cost;      /* time of the last refresh of each tile, ns */
+    int                  next;
+};
+
+tiles_t *tiles_new(breeder_t *breeder) {
+    tiles_t *tiles;
+    int      idx;
+    
+    tiles = qrt_new(tiles_t);
+    
+    if(tiles == NULL) {
+        return NULL;
+    }
+    
+    tiles->breeder  = breeder;
+    tiles->next     = 0;
+    tiles->snapshot = scene_snapshot_new();
+    tiles->cost     = qrt_new_array(int64_t, breeder_scene_count(breeder));
+    
+    if(tiles->snapshot == NULL || tiles->cost == NULL || !breeder_enable_snapshots(breeder)) {
+        tiles_free(tiles);
+        return NULL;
+    }
+    
+    for(idx = 0; idx < breeder_scene_count(breeder); ++idx) {
+        tiles->cost[idx] = 0;
+    }
+    
+    return tiles;
+}
+
+void tiles_free(tiles_t *tiles) {
+    if(tiles != NULL) {
+        scene_snapshot_free(tiles->snapshot);
+        free(tiles->cost);
+    }
+    
+    free(tiles);
+}
+
+/* Number of columns for which the tiles are the largest */
+static int best_columns(int count, const SDL_Rect *area) {
+    float    scale, best_scale;
+    float    scale_h;
+    int      columns, best;
+    int      rows;
+    
+    best        = 1;
+    best_scale  = 0.0;
+    
+    for(columns = 1; columns <= count; ++columns) {
+        rows    = (count + columns - 1) / columns;
+        scale   = (float)(area->w - (columns - 1) * TILES_GAP) / (float)(columns * SCENE_WIDTH);
+        scale_h = (float)(area->h - (rows - 1) * TILES_GAP)    / (float)(rows * SCENE_HEIGHT);
+        
+        if(scale_h < scale) {
+            scale = scale_h;
+        }
+        
+        if(scale > best_scale) {
+            best_scale  = scale;
+            best        = columns;
+        }
+    }
+    
+    return best;
+}
+
+static void render_tile(tiles_t *tiles, int index, SDL_Surface *screen, const SDL_Rect *rect) {
+    SDL_Rect     fill;
+    
+    fill = *rect;
+    SDL_FillRect(screen, &fill, COLOUR_TILE_BG);
+    
+    if(!breeder_scene_snapshot(tiles->breeder, index, tiles->snapshot)) {
+        return;
+    }
+    
+    /* Level of detail: sprites if the scene fits at full size, with room for
+     * things on its edges, and squares otherwise. */
+    if(rect->w >= scene_snapshot_get_width(tiles->snapshot) + 2 * SPRITE_MAX_BOUND && rect->h >= scene_snapshot_get_height(tiles->snapshot) + 2 * SPRITE_MAX_BOUND) {
+        scene_snapshot_render(tiles->snapshot, screen, rect->y + SPRITE_MAX_BOUND, rect->x + SPRITE_MAX_BOUND);
+    }
+    else {
+        scene_snapshot_render_dots(tiles->snapshot, screen, rect);
+    }
+}
+
+/* Render the tiles that fit in the frame budget within this area, starting
+ * after the last tile rendered in the previous frame. Each tile is expected to
+ * take as long as its last refresh, and is left for a later frame if that
+ * would exceed the budget. The rectangles of the tiles rendered, at most max,
+ * are written to rects for SDL_UpdateRects(). Returns their number. */
+int tiles_render(tiles_t *tiles, SDL_Surface *screen, const SDL_Rect *area, SDL_Rect *rects, int max) {
+    SDL_Rect    *rect;
+    int64_t      start;
+    int64_t      tile_start;
+    int64_t      now;
+    int          count;
+    int          columns;
+    int          rows;
+    int          width;
+    int          height;
+    int          rendered;
+    int          index;
+    
+    count   = breeder_scene_count(tiles->breeder);
+    columns = best_columns(count, area);
+    rows    = (count + columns - 1) / columns;
+    width   = (area->w - (columns - 1) * TILES_GAP) / columns;
+    height  = (area->h - (rows - 1) * TILES_GAP) / rows;
+    start   = frame_clock_now();
+    
+    if(width < 1 || height < 1) {
+        return 0;
+    }
+    
+    now = start;
+    
+    for(rendered = 0; rendered < count && rendered < max; ++rendered) {
+        index = tiles->next;
+        
+        /* at least one tile per frame */
+        if(rendered > 0 && now - start + tiles->cost[index] > TILES_FRAME_BUDGET) {
+            break;
+        }
+        
+        tiles->next = (index + 1) % count;
+        
+        rect        = &rects[rendered];
+        rect->x     = area->x + (index % columns) * (width  + TILES_GAP);
+        rect->y     = area->y + (index / columns) * (height + TILES_GAP);
+        rect->w     = width;
+        rect->h     = height;
+        
+        tile_start = now;
+        render_tile(tiles, index, screen, rect);
+        
+        now = frame_clock_now();
+        tiles->cost[index] = now - tile_start;
+    }
+    
+    return rendered;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2014-2018 Philippe Aubertin.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Benchmark of the rendering of the GUI window.
+ * 
+ * For a series of window sizes, renders a scene with five random critters
+ * with the window in memory (SDL dummy video driver, unless another one is
+ * selected with the SDL_VIDEODRIVER environment variable). The time to
+ * redraw the whole window (e.g. after it has been resized or exposed) and
+ * the time of a regular frame, where only the regions where things move are
+ * redrawn, are printed in CSV format, in microseconds.
+ * 
+ * Usage: window-bench [frames] */
+
+#define _POSIX_C_SOURCE 200112L
+#include <SDL/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "critter.h"
+#include "frame.h"
+#include "genome.h"
+#include "scene.h"
+#include "window.h"
+
+#define DEFAULT_FRAMES  200
+
+#define CRITTERS        5
+
+typedef struct {
+    int width;
+    int height;
+} bench_size_t;
+
+static const bench_size_t sizes[] = {
+    { 800,  500},
+    {1280,  720},
+    {1920, 1080},
+    {2560, 1440},
+    {3840, 2160}
+};
+
+#define SIZES   (sizeof(sizes) / sizeof(sizes[0]))
+
+
+int main(int argc, char *argv[]) {
+    scene_t     *scene;
+    window_t    *window;
+    critter_t   *critter;
+    genome_t    *genome;
+    int64_t      start;
+    int64_t      full_ns;
+    int64_t      frame_ns;
+    int          frames;
+    int          frame;
+    int          idx;
+    
+    frames = (argc > 1) ? atoi(argv[1]) : DEFAULT_FRAMES;
+    
+    if(frames <= 0) {
+        fprintf(stderr, "Usage: %s [frames]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    srand(time(NULL));
+    
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    
+    if(SDL_Init(SDL_INIT_VIDEO) != 0) {
+        fprintf(stderr, "Unable to init SDL: %s\n", SDL_GetError());
+        return EXIT_FAILURE;
+    }
+    
+    atexit(SDL_Quit);
+    
+    scene = scene_new();
+    
+    if(scene == NULL) {
+        fprintf(stderr, "Cannot create scene\n");
+        return EXIT_FAILURE;
+    }
+    
+    for(idx = 0; idx < CRITTERS; ++idx) {
+        genome = genome_new();
+        
+        if(genome != NULL) {
+            genome_make_random(genome);
+            critter = critter_new(genome);
+            
+            if(critter != NULL) {
+                scene_add_critter(scene, critter);
+            }
+            
+            genome_free(genome);
+        }
+    }
+    
+    window = window_new(scene);
+    
+    if(window == NULL) {
+        fprintf(stderr, "Cannot create window\n");
+        return EXIT_FAILURE;
+    }
+    
+    /* a fixed number of time steps per update, regardless of the time */
+    window_set_fast_forward(window, true);
+    
+    printf("width,height,full_frame_us,frame_us\n");
+    
+    for(idx = 0; idx < SIZES; ++idx) {
+        window_resize(window, sizes[idx].width, sizes[idx].height);
+        window_render(window);
+        
+        full_ns     = 0;
+        frame_ns    = 0;
+        
+        for(frame = 0; frame < frames; ++frame) {
+            window_update(window);
+            
+            window_invalidate(window);
+            
+            start = frame_clock_now();
+            window_render(window);
+            full_ns += frame_clock_now() - start;
+            
+            window_update(window);
+            
+            start = frame_clock_now();
+            window_render(window);
+            frame_ns += frame_clock_now() - start;
+        }
+        
+        printf("%d,%d,%.1f,%.1f\n",
+            sizes[idx].width,
+            sizes[idx].height,
+            (double)full_ns / frames / 1e3,
+            (double)frame_ns / frames / 1e3);
+    }
+    
+    window_free(window);
+    scene_free(scene);
+    
+    return EXIT_SUCCESS;
+}
@@ -28,8 +28,16 @@
 
 #include <SDL/SDL.h>
 #include <quatre/macros.h>
+#include <emmintrin.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "breeder.h"
+#include "frame.h"
 #include "util.h"
 #include "window.h"
 
@@ -46,41 +54,249 @@
 
 #define MILLISECONDS_PER_SECOND 1000
 
+/* Maximum number of rectangles redrawn by window_render(): the things and
+ * critters at their positions in the previous frame and in this one. If there
+ * are more, the whole window is redrawn. */
+#define WINDOW_DIRTY_RECTS  64
+
+/* Position of the HUD (see hud.h) from the top left corner of the scene */
+#define PIXELS_HUD_OFFSET   4
+
+/* Minimum size of the window, in pixels */
+#define WINDOW_MIN_WIDTH    200
+
+#define WINDOW_MIN_HEIGHT   150
+
+/* Number of different kinds of rows in the window background (see
+ * build_background()) */
+#define BACKGROUND_ROWS     4
+
+/* The scene is updated with the same time step as during training (see
+ * BREEDER_TIME_STEP), in seconds */
+#define WINDOW_TIME_STEP    ((float)BREEDER_TIME_STEP / (float)MILLISECONDS_PER_SECOND)
+
+/* Maximum number of time steps per window update. If updates are late by
+ * more than this, the scene slows down instead of running all the steps. */
+#define WINDOW_MAX_STEPS    5
+
+/* Number of time steps per window update in fast-forward mode */
+#define WINDOW_FAST_FORWARD_STEPS   4
+
 
 struct window_t {
     SDL_Surface *screen;
     SDL_Rect     scene_rect;
     SDL_Rect     border_rect;
     SDL_Rect     surface_rect;
+    SDL_Rect     inner_border_rect;
+    SDL_Rect     dirty[WINDOW_DIRTY_RECTS];
+    Uint32      *background;
+    int          background_pitch;
+    int          previous;
     scene_t     *scene;
+    hud_t       *hud;
+    int64_t      update_time;
+    scene_snapshot_t *before;
+    scene_snapshot_t *after;
+    scene_snapshot_t *display;
+    float        accumulator;
+    bool         fast_forward;
+    bool         tiled;
     int          ticks;
 };
 
+static bool rect_intersect(SDL_Rect *result, const SDL_Rect *a, const SDL_Rect *b) {
+    int x1, y1;
+    int x2, y2;
+    
+    x1 = (a->x > b->x) ? a->x : b->x;
+    y1 = (a->y > b->y) ? a->y : b->y;
+    x2 = (a->x + a->w < b->x + b->w) ? a->x + a->w : b->x + b->w;
+    y2 = (a->y + a->h < b->y + b->h) ? a->y + a->h : b->y + b->h;
+    
+    if(x2 <= x1 || y2 <= y1) {
+        return false;
+    }
+    
+    result->x = x1;
+    result->y = y1;
+    result->w = x2 - x1;
+    result->h = y2 - y1;
+    
+    return true;
+}
+
+/* Fill pixels first to last - 1 of a row */
+static void fill_span(Uint32 *row, int first, int last, Uint32 colour) {
+    __m128i  value;
+    int      idx;
+    
+    value   = _mm_set1_epi32(colour);
+    idx     = first;
+    
+    while(idx < last && ((uintptr_t)&row[idx] & 15) != 0) {
+        row[idx++] = colour;
+    }
+    
+    for(; idx + 4 <= last; idx += 4) {
+        _mm_store_si128((__m128i *)&row[idx], value);
+    }
+    
+    while(idx < last) {
+        row[idx++] = colour;
+    }
+}
+
+/* The window background is made of nested rectangles: the whole window, the
+ * border, the inside of the border and the scene */
+static const SDL_Rect *background_rect(window_t *window, int depth) {
+    switch(depth) {
+    case 0:
+        return &window->surface_rect;
+    case 1:
+        return &window->border_rect;
+    case 2:
+        return &window->inner_border_rect;
+    default:
+        return &window->scene_rect;
+    }
+}
+
+/* Number of nested rectangles, after the whole window, that contain row y */
+static int background_depth(window_t *window, int y) {
+    const SDL_Rect  *rect;
+    int              depth;
+    
+    for(depth = 0; depth < BACKGROUND_ROWS - 1; ++depth) {
+        rect = background_rect(window, depth + 1);
+        
+        if(y < rect->y || y >= rect->y + rect->h) {
+            break;
+        }
+    }
+    
+    return depth;
+}
+
+/* Draw the window background (margin, border and empty scene) in memory, so
+ * the background of each frame is copied from it instead of being filled
+ * again. All rows that are within the same nested rectangles are the same,
+ * so only one row of each kind is drawn, which makes this independent of
+ * the height of the window. Each pixel of a row is written once: the left
+ * edges of the nested rectangles, the innermost one, then their right
+ * edges. */
+static void build_background(window_t *window) {
+    static const Uint32 colours[BACKGROUND_ROWS] = {
+        COLOUR_WINDOW_BG,
+        COLOUR_BORDER,
+        COLOUR_WINDOW_BG,
+        COLOUR_SCENE_BG
+    };
+    
+    const SDL_Rect  *outer;
+    const SDL_Rect  *inner;
+    Uint32          *row;
+    int              depth;
+    int              idx;
+    
+    for(depth = 0; depth < BACKGROUND_ROWS; ++depth) {
+        row = &window->background[depth * window->background_pitch];
+        
+        for(idx = 0; idx < depth; ++idx) {
+            outer = background_rect(window, idx);
+            inner = background_rect(window, idx + 1);
+            fill_span(row, outer->x, inner->x, colours[idx]);
+        }
+        
+        inner = background_rect(window, depth);
+        fill_span(row, inner->x, inner->x + inner->w, colours[depth]);
+        
+        for(idx = depth - 1; idx >= 0; --idx) {
+            outer = background_rect(window, idx);
+            inner = background_rect(window, idx + 1);
+            fill_span(row, inner->x + inner->w, outer->x + outer->w, colours[idx]);
+        }
+    }
+}
+
+/* Redraw the window background within this rectangle, copied from the rows
+ * drawn by build_background() */
+static void clear_rect(window_t *window, const SDL_Rect *rect) {
+    SDL_Surface *screen;
+    SDL_Rect     area;
+    Uint32      *row;
+    Uint8       *pixels;
+    int          y;
+    
+    if(! rect_intersect(&area, rect, &window->surface_rect)) {
+        return;
+    }
+    
+    screen  = window->screen;
+    pixels  = (Uint8 *)screen->pixels + area.x * sizeof(Uint32);
+    
+    for(y = area.y; y < area.y + area.h; ++y) {
+        row = &window->background[background_depth(window, y) * window->background_pitch];
+        
+        memcpy(pixels + y * screen->pitch, &row[area.x], area.w * sizeof(Uint32));
+    }
+}
+
 window_t *window_new(scene_t *scene) {
     window_t     *window;
     
     window = qrt_new(window_t);
     
     if(window != NULL) {
-        window->scene  = scene;
-        window->ticks  = SDL_GetTicks();
+        window->scene           = scene;
+        window->hud             = NULL;
+        window->update_time     = 0;
+        window->ticks           = SDL_GetTicks();
+        window->accumulator     = 0.0;
+        window->fast_forward    = false;
+        window->tiled           = false;
+        window->background      = NULL;
+        window->background_pitch = 0;
+        window->before          = scene_snapshot_new();
+        window->after           = scene_snapshot_new();
+        window->display         = scene_snapshot_new();
+        
+        if(window->before == NULL || window->after == NULL || window->display == NULL) {
+            window_free(window);
+            return NULL;
+        }
         
         SDL_WM_SetCaption("Critters", "Critters");
         
         window_resize(window, WINDOW_WIDTH, WINDOW_HEIGHT);
+        
+        scene_snapshot_take(window->before, scene);
+        scene_snapshot_take(window->after,  scene);
     }
     
     return window;
 }
 
 void window_free(window_t *window) {
+    if(window != NULL) {
+        scene_snapshot_free(window->before);
+        scene_snapshot_free(window->after);
+        scene_snapshot_free(window->display);
+        free(window->background);
+    }
+    
     free(window);
 }
 
+/* Set the size of the window, e.g. when it is resized by the user
+ * (SDL_VIDEORESIZE event). The cached background and sprites are reused. */
 void window_resize(window_t *window, int width, int height) {
     SDL_Surface *screen;
     
-    screen = SDL_SetVideoMode(width, height, 32, SDL_SWSURFACE);
+    width   = (width  > WINDOW_MIN_WIDTH)  ? width  : WINDOW_MIN_WIDTH;
+    height  = (height > WINDOW_MIN_HEIGHT) ? height : WINDOW_MIN_HEIGHT;
+    
+    screen = SDL_SetVideoMode(width, height, 32, SDL_SWSURFACE | SDL_RESIZABLE);
     
     if(screen == NULL) {
         fprintf(stderr, "Unable to set video mode (%i x %i): %s\n",
@@ -102,20 +318,88 @@ void window_resize(window_t *window, int width, int height) {
         window->border_rect.w   = width  - 2 * PIXELS_MARGIN;
         window->border_rect.h   = height - 2 * PIXELS_MARGIN;
         
+        window->inner_border_rect.x = window->border_rect.x + 1;
+        window->inner_border_rect.y = window->border_rect.y + 1;
+        window->inner_border_rect.w = window->border_rect.w - 2;
+        window->inner_border_rect.h = window->border_rect.h - 2;
+        
         window->scene_rect.x    = PIXELS_MARGIN + PIXELS_BORDER;
         window->scene_rect.y    = PIXELS_MARGIN + PIXELS_BORDER;
         window->scene_rect.w    = width  - 2 * (PIXELS_MARGIN + PIXELS_BORDER);
         window->scene_rect.h    = height - 2 * (PIXELS_MARGIN + PIXELS_BORDER);
         
+        /* only reallocated when the window becomes wider than ever */
+        if(width > window->background_pitch) {
+            free(window->background);
+            
+            window->background_pitch    = (width + 3) & ~3;
+            window->background          = memalign(16, BACKGROUND_ROWS * window->background_pitch * sizeof(Uint32));
+            
+            if(window->background == NULL) {
+                fprintf(stderr, "Unable to allocate the window background (%i x %i)\n", width, height);
+                exit(EXIT_FAILURE);
+            }
+        }
+        
+        build_background(window);
+        
+        /* The things keep their positions relative to the scene. The scene
+         * is not interpolated across the change of scale. */
         scene_resize(window->scene, window->scene_rect.w, window->scene_rect.h);
+        
+        if(window->before != NULL && window->after != NULL) {
+            scene_snapshot_take(window->before, window->scene);
+            scene_snapshot_take(window->after,  window->scene);
+        }
+        
+        window_invalidate(window);
     }
 }
 
-void window_render(window_t *window) {
+/* Redraw the whole window in the next frame, e.g. when it has been exposed */
+void window_invalidate(window_t *window) {
+    window->previous    = -1;
+    window->tiled       = false;
+}
+
+/* Draw the HUD, if there is one, over the scene and add its area to the
+ * rectangles updated on screen. Returns the new number of rectangles. */
+static int render_hud(window_t *window, SDL_Rect *rects, int count, int64_t start) {
+    if(window->hud == NULL) {
+        return count;
+    }
+    
+    hud_add_frame(window->hud, window->update_time + frame_clock_now() - start);
+    
+    if(count >= WINDOW_DIRTY_RECTS) {
+        rects[0]    = window->surface_rect;
+        count       = 1;
+    }
+    
+    hud_render(
+            window->hud,
+            window->screen,
+            window->scene_rect.x + PIXELS_HUD_OFFSET,
+            window->scene_rect.y + PIXELS_HUD_OFFSET,
+            &rects[count]);
+    
+    return count + 1;
+}
+
+/* Only the regions of the window where things were in the previous frame and
+ * where they are in this one are redrawn and updated on screen. */
+static void render_frame(window_t *window, scene_snapshot_t *snapshot) {
     SDL_Surface *screen;
-    SDL_Rect     inner_border_rect;
+    SDL_Rect    *dirty;
+    int64_t      start;
+    int          previous;
+    int          count;
+    int          idx;
     
+    start       = frame_clock_now();
     screen      = window->screen;
+    dirty       = window->dirty;
+    previous    = window->previous;
     
     if(SDL_MUSTLOCK(screen)) {
         if (SDL_LockSurface(screen) != 0) {
@@ -123,38 +407,196 @@ void window_render(window_t *window) {
         }
     }
     
-    /* clean scene */
-    inner_border_rect.x = window->border_rect.x + 1;
-    inner_border_rect.y = window->border_rect.y + 1;
-    inner_border_rect.w = window->border_rect.w - 2;
-    inner_border_rect.h = window->border_rect.h - 2;
+    /* The rectangles of the previous frame are at the start of the dirty
+     * array, add those of this frame after them. */
+    count = -1;
     
-    SDL_FillRect(window->screen, &window->surface_rect, COLOUR_WINDOW_BG);
-    SDL_FillRect(window->screen, &window->border_rect,  COLOUR_BORDER);
-    SDL_FillRect(window->screen, &inner_border_rect,    COLOUR_WINDOW_BG);
-    SDL_FillRect(window->screen, &window->scene_rect,   COLOUR_SCENE_BG);
+    if(previous >= 0 && !window->tiled) {
+        count = scene_snapshot_get_rects(
+                snapshot,
+                &dirty[previous],
+                WINDOW_DIRTY_RECTS - previous,
+                window->scene_rect.x,
+                window->scene_rect.y);
+    }
+    
+    if(count < 0) {
+        dirty[0]    = window->surface_rect;
+        count       = 1;
+    }
+    else {
+        /* SDL_UpdateRects() requires rectangles within the screen */
+        count += previous;
+        previous = 0;
+        
+        for(idx = 0; idx < count; ++idx) {
+            if(rect_intersect(&dirty[previous], &dirty[idx], &window->surface_rect)) {
+                ++previous;
+            }
+        }
+        
+        count = previous;
+    }
+    
+    /* clean scene */
+    for(idx = 0; idx < count; ++idx) {
+        clear_rect(window, &dirty[idx]);
+    }
     
     /* render scene content */
-    scene_render(window->scene, screen, window->scene_rect.x, window->scene_rect.y);
+    scene_snapshot_render(snapshot, screen, window->scene_rect.x, window->scene_rect.y);
+    
+    count = render_hud(window, dirty, count, start);
     
     if (SDL_MUSTLOCK(screen)) {
         SDL_UnlockSurface(screen);
     }
 
-    SDL_UpdateRect(screen, window->surface_rect.x, window->surface_rect.y, window->surface_rect.w, window->surface_rect.h);
+    SDL_UpdateRects(screen, count, dirty);
+    
+    window->tiled = false;
+    
+    /* these are dirty in the next frame */
+    window->previous = scene_snapshot_get_rects(
+            snapshot,
+            dirty,
+            WINDOW_DIRTY_RECTS,
+            window->scene_rect.x,
+            window->scene_rect.y);
+}
+
+/* Render the scene as it is between the last two time steps, according to
+ * the time elapsed since the last one (see window_update()) */
+void window_render(window_t *window) {
+    window_snapshot(window, window->display);
+    render_frame(window, window->display);
 }
 
+/* Render a snapshot taken with window_snapshot() instead. This does not
+ * access the scene, so it can be called by another thread than the one that
+ * updates the scene. */
+void window_render_snapshot(window_t *window, scene_snapshot_t *snapshot) {
+    render_frame(window, snapshot);
+}
+
+/* Render the tiled view (see tiles.h) in the scene area instead of the scene.
+ * Only the tiles that are refreshed are updated on screen. */
+void window_render_tiles(window_t *window, tiles_t *tiles) {
+    SDL_Surface *screen;
+    int64_t      start;
+    int          count;
+    
+    start   = frame_clock_now();
+    screen  = window->screen;
+    
+    if(SDL_MUSTLOCK(screen)) {
+        if (SDL_LockSurface(screen) != 0) {
+            return;
+        }
+    }
+    
+    /* things of the scene may have been drawn beyond the scene area */
+    if(!window->tiled) {
+        clear_rect(window, &window->surface_rect);
+    }
+    
+    count = tiles_render(tiles, screen, &window->scene_rect, window->dirty, WINDOW_DIRTY_RECTS);
+    count = render_hud(window, window->dirty, count, start);
+    
+    if (SDL_MUSTLOCK(screen)) {
+        SDL_UnlockSurface(screen);
+    }
+    
+    if(!window->tiled) {
+        SDL_UpdateRect(screen, window->surface_rect.x, window->surface_rect.y, window->surface_rect.w, window->surface_rect.h);
+    }
+    else {
+        SDL_UpdateRects(screen, count, window->dirty);
+    }
+    
+    window->tiled = true;
+}
+
+/* Take a snapshot of the scene as it is rendered by window_render() */
+void window_snapshot(window_t *window, scene_snapshot_t *snapshot) {
+    float alpha;
+    
+    if(window->fast_forward) {
+        alpha = 1.0;
+    }
+    else {
+        alpha = window->accumulator / WINDOW_TIME_STEP;
+    }
+    
+    scene_snapshot_interpolate(snapshot, window->before, window->after, alpha);
+}
+
+/* Show this HUD over the scene, or none if NULL */
+void window_set_hud(window_t *window, hud_t *hud) {
+    window->hud = hud;
+    window_invalidate(window);
+}
+
+/* In fast-forward mode, the scene is updated by WINDOW_FAST_FORWARD_STEPS
+ * time steps per window update regardless of the time elapsed. */
+void window_set_fast_forward(window_t *window, bool fast_forward) {
+    window->fast_forward    = fast_forward;
+    window->accumulator     = 0.0;
+}
+
+bool window_get_fast_forward(window_t *window) {
+    return window->fast_forward;
+}
+
+static void step(window_t *window) {
+    scene_snapshot_t *snapshot;
+    int64_t           start;
+    
+    start           = frame_clock_now();
+    snapshot        = window->before;
+    window->before  = window->after;
+    window->after   = snapshot;
+    
+    scene_update(window->scene, WINDOW_TIME_STEP);
+    scene_snapshot_take(window->after, window->scene);
+    
+    window->update_time += frame_clock_now() - start;
+}
+
+/* The scene is updated in time steps of the same duration as during training
+ * so critters behave as they did when their fitness was computed. The time
+ * elapsed that does not make a whole time step is carried over to the next
+ * update, and is used by window_render() to interpolate the positions between
+ * the last two time steps. */
 void window_update(window_t *window) {
     int ticks_now;
     int ticks_prev;
+    int steps;
     float delta;
     
     ticks_prev    = window->ticks;
     ticks_now     = SDL_GetTicks();
     
-    window->ticks = ticks_now;
+    window->ticks       = ticks_now;
+    window->update_time = 0;
     
     delta = (float)(ticks_now - ticks_prev) / (float)MILLISECONDS_PER_SECOND;
     
-    scene_update(window->scene, delta);
+    if(window->fast_forward) {
+        for(steps = 0; steps < WINDOW_FAST_FORWARD_STEPS; ++steps) {
+            step(window);
+        }
+        
+        return;
+    }
+    
+    window->accumulator += delta;
+    
+    for(steps = 0; steps < WINDOW_MAX_STEPS && window->accumulator >= WINDOW_TIME_STEP; ++steps) {
+        step(window);
+        window->accumulator -= WINDOW_TIME_STEP;
+    }
+    
+    /* too late, drop the time steps that were not run */
+    window->accumulator = fminf(window->accumulator, WINDOW_TIME_STEP);
 }
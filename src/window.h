@@ -29,7 +29,9 @@
 #ifndef CRITTERS_WINDOW_H_
 #define CRITTERS_WINDOW_H_
 
+#include "hud.h"
 #include "scene.h"
+#include "tiles.h"
 
 #define WINDOW_WIDTH    800
 
@@ -45,8 +47,22 @@ void window_free(window_t *window);
 
 void window_resize(window_t *window, int width, int height);
 
+void window_invalidate(window_t *window);
+
 void window_render(window_t *window);
 
+void window_render_snapshot(window_t *window, scene_snapshot_t *snapshot);
+
+void window_render_tiles(window_t *window, tiles_t *tiles);
+
+void window_snapshot(window_t *window, scene_snapshot_t *snapshot);
+
+void window_set_hud(window_t *window, hud_t *hud);
+
+void window_set_fast_forward(window_t *window, bool fast_forward);
+
+bool window_get_fast_forward(window_t *window);
+
 void window_update(window_t *window);
 
 #endif